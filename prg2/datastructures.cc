@@ -6,17 +6,1969 @@
 
 #include <cmath>
 
+#include <algorithm>
+
+#include <cctype>
+
+#include <atomic>
+#include <system_error>
+#include <thread>
+
+#if defined(__AVX2__) || defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
+
 std::minstd_rand rand_engine; // Reasonably quick pseudo-random generator
 
-template <typename Type>
-Type random_in_range(Type start, Type end)
+template <typename Type>
+Type random_in_range(Type start, Type end)
+{
+    auto range = end-start;
+    ++range;
+
+    auto num = std::uniform_int_distribution<unsigned long int>(0, range-1)(rand_engine);
+
+    return static_cast<Type>(start+num);
+}
+
+// Rounds the square root of value down exactly. The floating point square root is
+// only used as a first guess, since it may be off by one for large values.
+long long integer_sqrt(long long value)
+{
+    long long root = static_cast<long long>(std::sqrt(static_cast<double>(value)));
+    while (root > 0 && root*root > value)
+    {
+        --root;
+    }
+    while ((root+1)*(root+1) <= value)
+    {
+        ++root;
+    }
+    return root;
+}
+
+void squared_distances(Coord const* coords, std::size_t count, Coord xy, long long* out)
+{
+    static_assert(sizeof(Coord) == 2*sizeof(int), "Coords are loaded as pairs of ints");
+    std::size_t i = 0;
+#if defined(__AVX2__)
+    // Each 64-bit lane holds one coordinate as (x, y). _mm256_mul_epi32 multiplies
+    // the signed low halves of the lanes, so dx*dx comes from the lanes as such and
+    // dy*dy after shifting y to the low half.
+    __m256i origin = _mm256_set_epi32(xy.y,xy.x,xy.y,xy.x,xy.y,xy.x,xy.y,xy.x);
+    for (; i+4 <= count; i += 4)
+    {
+        __m256i diff = _mm256_sub_epi32(_mm256_loadu_si256(reinterpret_cast<__m256i const*>(coords+i)),origin);
+        __m256i dx2 = _mm256_mul_epi32(diff,diff);
+        __m256i dy = _mm256_srli_epi64(diff,32);
+        __m256i dy2 = _mm256_mul_epi32(dy,dy);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out+i),_mm256_add_epi64(dx2,dy2));
+    }
+#elif defined(__SSE4_1__)
+    // Same as above with two coordinates at a time.
+    __m128i origin = _mm_set_epi32(xy.y,xy.x,xy.y,xy.x);
+    for (; i+2 <= count; i += 2)
+    {
+        __m128i diff = _mm_sub_epi32(_mm_loadu_si128(reinterpret_cast<__m128i const*>(coords+i)),origin);
+        __m128i dx2 = _mm_mul_epi32(diff,diff);
+        __m128i dy = _mm_srli_epi64(diff,32);
+        __m128i dy2 = _mm_mul_epi32(dy,dy);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out+i),_mm_add_epi64(dx2,dy2));
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        long long dx = static_cast<long long>(coords[i].x) - xy.x;
+        long long dy = static_cast<long long>(coords[i].y) - xy.y;
+        out[i] = dx*dx + dy*dy;
+    }
+}
+
+void cross_products(Coord const* coords, std::size_t count, long long* out)
+{
+    static_assert(sizeof(Coord) == 2*sizeof(int), "Coords are loaded as pairs of ints");
+    std::size_t i = 0;
+#if defined(__AVX2__)
+    // Each 64-bit lane holds one coordinate as (x, y) like in squared_distances, and the
+    // lanes of b are the next coordinates. x[i]*y[i+1] comes from the low half of a and the
+    // high half of b, and x[i+1]*y[i] the other way around.
+    for (; i+5 <= count; i += 4)
+    {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(coords+i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(coords+i+1));
+        __m256i xa_yb = _mm256_mul_epi32(a,_mm256_srli_epi64(b,32));
+        __m256i xb_ya = _mm256_mul_epi32(b,_mm256_srli_epi64(a,32));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out+i),_mm256_sub_epi64(xa_yb,xb_ya));
+    }
+#elif defined(__SSE4_1__)
+    // Same as above with two coordinates at a time.
+    for (; i+3 <= count; i += 2)
+    {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<__m128i const*>(coords+i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<__m128i const*>(coords+i+1));
+        __m128i xa_yb = _mm_mul_epi32(a,_mm_srli_epi64(b,32));
+        __m128i xb_ya = _mm_mul_epi32(b,_mm_srli_epi64(a,32));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out+i),_mm_sub_epi64(xa_yb,xb_ya));
+    }
+#endif
+    for (; i+1 < count; ++i)
+    {
+        out[i] = static_cast<long long>(coords[i].x)*coords[i+1].y - static_cast<long long>(coords[i+1].x)*coords[i].y;
+    }
+}
+
+// Does the edge a -> b cross the ray from xy to the right. The ends are counted as
+// above or below xy.y like in the usual crossing number test, so that a ray through
+// a vertex is crossed once.
+bool edge_crosses_ray(Coord a, Coord b, Coord xy)
+{
+    if ((a.y > xy.y) == (b.y > xy.y))
+    {
+        return false;
+    }
+    // The sign of side tells which side of the edge xy is on.
+    long long side = (static_cast<long long>(xy.x)-a.x)*(static_cast<long long>(b.y)-a.y)
+                   - (static_cast<long long>(b.x)-a.x)*(static_cast<long long>(xy.y)-a.y);
+    return b.y > a.y ? side < 0 : side > 0;
+}
+
+// Is xy on the edge a -> b, the ends included.
+bool on_edge(Coord a, Coord b, Coord xy)
+{
+    long long side = (static_cast<long long>(xy.x)-a.x)*(static_cast<long long>(b.y)-a.y)
+                   - (static_cast<long long>(b.x)-a.x)*(static_cast<long long>(xy.y)-a.y);
+    return side == 0 && std::min(a.x,b.x) <= xy.x && xy.x <= std::max(a.x,b.x)
+                     && std::min(a.y,b.y) <= xy.y && xy.y <= std::max(a.y,b.y);
+}
+
+// Is xy on one of the edges of the polygon shape[0..count).
+bool on_polygon_boundary(Coord const* shape, std::size_t count, Coord xy)
+{
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        if (on_edge(shape[i],shape[i+1 < count ? i+1 : 0],xy))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Same for a packed shape, decoded in blocks like in point_in_polygon below.
+bool on_polygon_boundary(PackedShape const& shape, Coord xy)
+{
+    constexpr std::size_t BLOCK_SIZE = 64;
+    Coord block[BLOCK_SIZE];
+    ShapeDecoder decoder(shape);
+    std::size_t count = decoder.next(block,BLOCK_SIZE);
+    Coord first = block[0];
+    while (true)
+    {
+        for (std::size_t i = 0; i+1 < count; ++i)
+        {
+            if (on_edge(block[i],block[i+1],xy))
+            {
+                return true;
+            }
+        }
+        Coord last = block[count-1];
+        if (decoder.done())
+        {
+            return on_edge(last,first,xy);
+        }
+        block[0] = last;
+        count = 1+decoder.next(block+1,BLOCK_SIZE-1);
+    }
+}
+
+// Does the ray from xy to the right cross the edges coords[i] -> coords[i+1] of the
+// polyline coords[0..count) an odd amount of times.
+bool odd_crossings(Coord const* coords, std::size_t count, Coord xy)
+{
+    bool odd = false;
+    std::size_t i = 0;
+#if defined(__AVX2__)
+    // Each 64-bit lane holds one of four consecutive edges: the start coordinate as
+    // (x, y) comes from coords+i and the end from coords+i+1, and the test is the same as
+    // in edge_crosses_ray. Only the parity of the crossings matters, so the lane masks
+    // are just xored together.
+    __m256i point = _mm256_set_epi32(xy.y,xy.x,xy.y,xy.x,xy.y,xy.x,xy.y,xy.x);
+    __m256i zero = _mm256_setzero_si256();
+    int parity = 0;
+    for (; i+5 <= count; i += 4)
+    {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(coords+i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(coords+i+1));
+        // Comparisons of the y halves, copied to the whole lanes.
+        __m256i a_above = _mm256_shuffle_epi32(_mm256_cmpgt_epi32(a,point),_MM_SHUFFLE(3,3,1,1));
+        __m256i b_above = _mm256_shuffle_epi32(_mm256_cmpgt_epi32(b,point),_MM_SHUFFLE(3,3,1,1));
+        __m256i straddles = _mm256_xor_si256(a_above,b_above);
+        if (_mm256_testz_si256(straddles,straddles))
+        {
+            continue; // most edges are entirely above or below xy
+        }
+        __m256i to_point = _mm256_sub_epi32(point,a);
+        __m256i edge = _mm256_sub_epi32(b,a);
+        __m256i upward = _mm256_shuffle_epi32(_mm256_cmpgt_epi32(edge,zero),_MM_SHUFFLE(3,3,1,1));
+        __m256i side = _mm256_sub_epi64(_mm256_mul_epi32(to_point,_mm256_srli_epi64(edge,32)),
+                                        _mm256_mul_epi32(edge,_mm256_srli_epi64(to_point,32)));
+        __m256i crosses = _mm256_and_si256(straddles,
+                                           _mm256_blendv_epi8(_mm256_cmpgt_epi64(side,zero),
+                                                              _mm256_cmpgt_epi64(zero,side),upward));
+        parity ^= _mm256_movemask_pd(_mm256_castsi256_pd(crosses));
+    }
+    odd = ((parity ^ (parity >> 1) ^ (parity >> 2) ^ (parity >> 3)) & 1) != 0;
+#endif
+    for (; i+1 < count; ++i)
+    {
+        odd ^= edge_crosses_ray(coords[i],coords[i+1],xy);
+    }
+    return odd;
+}
+
+bool point_in_polygon(Coord const* shape, std::size_t count, Coord xy)
+{
+    if (count == 0)
+    {
+        return false;
+    }
+    if (odd_crossings(shape,count,xy) != edge_crosses_ray(shape[count-1],shape[0],xy))
+    {
+        return true;
+    }
+    // The crossing number test leaves the points on some of the edges outside, so the
+    // points it leaves outside are checked against the edges.
+    return on_polygon_boundary(shape,count,xy);
+}
+
+bool point_in_polygon(PackedShape const& shape, Coord xy)
+{
+    if (shape.empty())
+    {
+        return false;
+    }
+    // Every block starts with the last coordinate of the previous block, so that the
+    // edges between the blocks are tested too.
+    constexpr std::size_t BLOCK_SIZE = 64;
+    Coord block[BLOCK_SIZE];
+    ShapeDecoder decoder(shape);
+    std::size_t count = decoder.next(block,BLOCK_SIZE);
+    Coord first = block[0];
+    bool inside = false;
+    while (true)
+    {
+        inside ^= odd_crossings(block,count,xy);
+        Coord last = block[count-1];
+        if (decoder.done())
+        {
+            return inside != edge_crosses_ray(last,first,xy) || on_polygon_boundary(shape,xy);
+        }
+        block[0] = last;
+        count = 1+decoder.next(block+1,BLOCK_SIZE-1);
+    }
+}
+
+bool polygon_in_polygon(Coord const* outer, std::size_t outer_count, Coord const* inner, std::size_t inner_count)
+{
+    if (outer_count == 0 || inner_count == 0)
+    {
+        return false;
+    }
+    for (std::size_t i = 0; i < inner_count; ++i)
+    {
+        if (!point_in_polygon(outer,outer_count,inner[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void PlaceGrid::insert(PlaceID id, Coord xy)
+{
+    long long cx = xy.x >> shift_;
+    long long cy = xy.y >> shift_;
+    Cell& cell = overflow_[cell_key_(cx,cy)];
+    cell.ids.push_back(id);
+    cell.coords.push_back(xy);
+    if (is_packed_cell_(cx,cy))
+    {
+        has_overflow_[packed_index_(cx,cy)] = true;
+    }
+    include_cell_(cx,cy);
+    ++overflow_size_;
+    ++size_;
+    if (size_ >= 2*built_size_ || overflow_size_+removed_ > built_size_)
+    {
+        rebuild_();
+    }
+}
+
+void PlaceGrid::erase(PlaceID id, Coord xy)
+{
+    long long cx = xy.x >> shift_;
+    long long cy = xy.y >> shift_;
+    bool found = false;
+    if (is_packed_cell_(cx,cy))
+    {
+        std::size_t index = packed_index_(cx,cy);
+        for (std::size_t i = cell_start_[index]; i < cell_start_[index+1]; ++i)
+        {
+            if (ids_[i] == id)
+            {
+                ids_[i] = NO_PLACE; // packed arrays are compacted in the next rebuild
+                ++removed_;
+                found = true;
+                break;
+            }
+        }
+    }
+    if (!found)
+    {
+        auto cellIt = overflow_.find(cell_key_(cx,cy));
+        if (cellIt == overflow_.end())
+        {
+            return;
+        }
+        Cell& cell = cellIt->second;
+        for (std::size_t i = 0; i < cell.ids.size(); ++i)
+        {
+            if (cell.ids[i] == id)
+            {
+                // swap-remove, the order inside a cell does not matter
+                cell.ids[i] = cell.ids.back();
+                cell.coords[i] = cell.coords.back();
+                cell.ids.pop_back();
+                cell.coords.pop_back();
+                --overflow_size_;
+                found = true;
+                break;
+            }
+        }
+        if (cell.ids.empty())
+        {
+            overflow_.erase(cellIt);
+        }
+    }
+    if (!found)
+    {
+        return;
+    }
+    --size_;
+    if (size_ < built_size_/4 || overflow_size_+removed_ > built_size_)
+    {
+        rebuild_();
+    }
+}
+
+void PlaceGrid::move(PlaceID id, Coord oldxy, Coord newxy)
+{
+    long long cx = oldxy.x >> shift_;
+    long long cy = oldxy.y >> shift_;
+    if (cx != (newxy.x >> shift_) || cy != (newxy.y >> shift_))
+    {
+        erase(id,oldxy);
+        insert(id,newxy);
+        return;
+    }
+    // Same cell, so the coordinate is just updated where the place is.
+    if (is_packed_cell_(cx,cy))
+    {
+        std::size_t index = packed_index_(cx,cy);
+        for (std::size_t i = cell_start_[index]; i < cell_start_[index+1]; ++i)
+        {
+            if (ids_[i] == id)
+            {
+                coords_[i] = newxy;
+                return;
+            }
+        }
+    }
+    auto cellIt = overflow_.find(cell_key_(cx,cy));
+    if (cellIt != overflow_.end())
+    {
+        Cell& cell = cellIt->second;
+        for (std::size_t i = 0; i < cell.ids.size(); ++i)
+        {
+            if (cell.ids[i] == id)
+            {
+                cell.coords[i] = newxy;
+                return;
+            }
+        }
+    }
+}
+
+void PlaceGrid::clear()
+{
+    *this = PlaceGrid();
+}
+
+std::vector<PlaceID> PlaceGrid::nearest(Coord xy, std::size_t k)
+{
+    if (size_ == 0 || k == 0)
+    {
+        return {};
+    }
+    compact_if_needed_();
+
+    // Max-heap of the k best candidates so far.
+    std::vector<Candidate> best;
+    best.reserve(k+1);
+
+    long long qcx = xy.x >> shift_;
+    long long qcy = xy.y >> shift_;
+    long long side = 1LL << shift_;
+
+    // Rings that are completely outside the occupied cell range are skipped.
+    long long ring = std::max({min_cx_-qcx, qcx-max_cx_, min_cy_-qcy, qcy-max_cy_, 0LL});
+    long long cell_count = packed_width_*packed_height_ + static_cast<long long>(overflow_.size());
+
+    if (ring == 0)
+    {
+        // The 3x3 cells around xy are nearly always needed, so they are visited as one block.
+        ring = 1;
+        visit_block_(qcx-1,qcx+1,qcy-1,qcy+1,xy,k,best);
+    }
+    else
+    {
+        visit_block_(qcx-ring,qcx+ring,qcy-ring,qcy-ring,xy,k,best);
+        visit_block_(qcx-ring,qcx+ring,qcy+ring,qcy+ring,xy,k,best);
+        visit_block_(qcx-ring,qcx-ring,qcy-ring+1,qcy+ring-1,xy,k,best);
+        visit_block_(qcx+ring,qcx+ring,qcy-ring+1,qcy+ring-1,xy,k,best);
+    }
+
+    while (true)
+    {
+        if (qcx-ring <= min_cx_ && qcx+ring >= max_cx_ && qcy-ring <= min_cy_ && qcy+ring >= max_cy_)
+        {
+            break; // every occupied cell has been visited
+        }
+        // Places that have not been visited are outside the square of visited cells,
+        // so they are at least this far from xy.
+        long long min_unvisited = std::min({xy.x - (qcx-ring)*side, (qcx+ring+1)*side - xy.x,
+                                            xy.y - (qcy-ring)*side, (qcy+ring+1)*side - xy.y});
+        if (best.size() == k && std::get<0>(best.front()) < min_unvisited*min_unvisited)
+        {
+            break;
+        }
+        ++ring;
+
+        // With very unevenly spread places the rings may get large and empty. If the
+        // rings would cover more cells than the grid has, it is cheaper to go
+        // through all places once.
+        if ((2*ring+1)*(2*ring+1) > 2*cell_count + 9)
+        {
+            best.clear();
+            visit_places_(ids_.data(),coords_.data(),ids_.size(),xy,k,best);
+            for (auto const& cell : overflow_)
+            {
+                visit_places_(cell.second.ids.data(),cell.second.coords.data(),cell.second.ids.size(),xy,k,best);
+            }
+            break;
+        }
+
+        // top and bottom rows, and left and right columns without the corners
+        visit_block_(qcx-ring,qcx+ring,qcy-ring,qcy-ring,xy,k,best);
+        visit_block_(qcx-ring,qcx+ring,qcy+ring,qcy+ring,xy,k,best);
+        visit_block_(qcx-ring,qcx-ring,qcy-ring+1,qcy+ring-1,xy,k,best);
+        visit_block_(qcx+ring,qcx+ring,qcy-ring+1,qcy+ring-1,xy,k,best);
+    }
+
+    std::sort_heap(best.begin(),best.end());
+    std::vector<PlaceID> result;
+    result.reserve(best.size());
+    for (auto const& candidate : best)
+    {
+        result.push_back(std::get<2>(candidate));
+    }
+    return result;
+}
+
+template <typename Func>
+void PlaceGrid::for_each_in_cells_(long long lo_x, long long hi_x, long long lo_y, long long hi_y, Func func) const
+{
+    lo_x = std::max(lo_x, min_cx_);
+    hi_x = std::min(hi_x, max_cx_);
+    lo_y = std::max(lo_y, min_cy_);
+    hi_y = std::min(hi_y, max_cy_);
+    if (lo_x > hi_x || lo_y > hi_y)
+    {
+        return;
+    }
+
+    // func gets continuous runs of places as (ids, coords, count). Runs of packed
+    // places may contain removed places, whose ID is NO_PLACE.
+    long long cell_count = packed_width_*packed_height_ + static_cast<long long>(overflow_.size());
+    if ((hi_x-lo_x+1)*(hi_y-lo_y+1) > 2*cell_count + 9)
+    {
+        // Most of the cells would be visited anyway, so all places are gone through once.
+        func(ids_.data(),coords_.data(),ids_.size());
+        for (auto const& cell : overflow_)
+        {
+            func(cell.second.ids.data(),cell.second.coords.data(),cell.second.ids.size());
+        }
+        return;
+    }
+
+    long long packed_lo_x = std::max(lo_x, packed_min_cx_);
+    long long packed_hi_x = std::min(hi_x, packed_min_cx_+packed_width_-1);
+    long long packed_lo_y = std::max(lo_y, packed_min_cy_);
+    long long packed_hi_y = std::min(hi_y, packed_min_cy_+packed_height_-1);
+    if (packed_lo_x <= packed_hi_x)
+    {
+        for (long long cy = packed_lo_y; cy <= packed_hi_y; ++cy)
+        {
+            // The packed part of a row is one continuous range of the arrays.
+            std::uint32_t begin = cell_start_[packed_index_(packed_lo_x,cy)];
+            std::uint32_t end = cell_start_[packed_index_(packed_hi_x,cy)+1];
+            func(ids_.data()+begin,coords_.data()+begin,end-begin);
+        }
+    }
+
+    if (overflow_size_ == 0)
+    {
+        return;
+    }
+    for (long long cy = lo_y; cy <= hi_y; ++cy)
+    {
+        for (long long cx = lo_x; cx <= hi_x; ++cx)
+        {
+            if (is_packed_cell_(cx,cy) && !has_overflow_[packed_index_(cx,cy)])
+            {
+                continue;
+            }
+            auto cellIt = overflow_.find(cell_key_(cx,cy));
+            if (cellIt != overflow_.end())
+            {
+                Cell const& cell = cellIt->second;
+                func(cell.ids.data(),cell.coords.data(),cell.ids.size());
+            }
+        }
+    }
+}
+
+std::vector<PlaceID> PlaceGrid::within_radius(Coord xy, long long radius)
+{
+    if (size_ == 0 || radius < 0)
+    {
+        return {};
+    }
+    compact_if_needed_();
+
+    long long radius_squared = radius*radius;
+    std::vector<Candidate> found;
+    for_each_in_cells_((xy.x-radius) >> shift_, (xy.x+radius) >> shift_,
+                       (xy.y-radius) >> shift_, (xy.y+radius) >> shift_,
+                       [&found, xy, radius_squared](PlaceID const* ids, Coord const* coords, std::size_t count)
+    {
+        constexpr std::size_t BLOCK_SIZE = 64;
+        long long dists[BLOCK_SIZE];
+        for (std::size_t start = 0; start < count; start += BLOCK_SIZE)
+        {
+            std::size_t block_count = std::min(BLOCK_SIZE, count-start);
+            squared_distances(coords+start,block_count,xy,dists);
+            for (std::size_t i = 0; i < block_count; ++i)
+            {
+                if (dists[i] <= radius_squared && ids[start+i] != NO_PLACE)
+                {
+                    found.emplace_back(dists[i], coords[start+i].y, ids[start+i]);
+                }
+            }
+        }
+    });
+
+    std::sort(found.begin(),found.end());
+    std::vector<PlaceID> result;
+    result.reserve(found.size());
+    for (auto const& candidate : found)
+    {
+        result.push_back(std::get<2>(candidate));
+    }
+    return result;
+}
+
+std::vector<PlaceID> PlaceGrid::in_rect(Coord min, Coord max)
+{
+    if (size_ == 0 || min.x > max.x || min.y > max.y)
+    {
+        return {};
+    }
+    compact_if_needed_();
+
+    std::vector<PlaceID> result;
+    for_each_in_cells_(min.x >> shift_, max.x >> shift_, min.y >> shift_, max.y >> shift_,
+                       [&result, min, max](PlaceID const* ids, Coord const* coords, std::size_t count)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            Coord xy = coords[i];
+            if (xy.x >= min.x && xy.x <= max.x && xy.y >= min.y && xy.y <= max.y && ids[i] != NO_PLACE)
+            {
+                result.push_back(ids[i]);
+            }
+        }
+    });
+    return result;
+}
+
+std::vector<PlaceID> PlaceGrid::in_polygon(Coord const* shape, std::size_t count, Coord min, Coord max)
+{
+    if (size_ == 0 || count == 0)
+    {
+        return {};
+    }
+    compact_if_needed_();
+
+    std::vector<PlaceID> result;
+    for_each_in_cells_(min.x >> shift_, max.x >> shift_, min.y >> shift_, max.y >> shift_,
+                       [&result, min, max, shape, count](PlaceID const* ids, Coord const* coords, std::size_t place_count)
+    {
+        for (std::size_t i = 0; i < place_count; ++i)
+        {
+            Coord xy = coords[i];
+            if (xy.x >= min.x && xy.x <= max.x && xy.y >= min.y && xy.y <= max.y && ids[i] != NO_PLACE &&
+                point_in_polygon(shape,count,xy))
+            {
+                result.push_back(ids[i]);
+            }
+        }
+    });
+    return result;
+}
+
+std::uint64_t PlaceGrid::cell_key_(long long cx, long long cy) const
+{
+    // Shifted as unsigned, because the cells of negative coordinates are negative.
+    return (static_cast<std::uint64_t>(cx) << 32) ^ static_cast<std::uint32_t>(cy);
+}
+
+bool PlaceGrid::is_packed_cell_(long long cx, long long cy) const
+{
+    return cx >= packed_min_cx_ && cx < packed_min_cx_+packed_width_ &&
+           cy >= packed_min_cy_ && cy < packed_min_cy_+packed_height_;
+}
+
+std::size_t PlaceGrid::packed_index_(long long cx, long long cy) const
+{
+    return static_cast<std::size_t>((cy-packed_min_cy_)*packed_width_ + (cx-packed_min_cx_));
+}
+
+void PlaceGrid::visit_block_(long long lo_x, long long hi_x, long long lo_y, long long hi_y,
+                             Coord xy, std::size_t k, std::vector<Candidate> & best) const
+{
+    lo_x = std::max(lo_x, min_cx_);
+    hi_x = std::min(hi_x, max_cx_);
+    lo_y = std::max(lo_y, min_cy_);
+    hi_y = std::min(hi_y, max_cy_);
+    if (lo_x > hi_x || lo_y > hi_y)
+    {
+        return;
+    }
+
+    // The packed part of each row is one continuous range of the arrays. The ranges
+    // of a few rows are located and prefetched before any of them is scanned, so that
+    // the cache misses of different rows overlap instead of waiting for each other.
+    long long packed_lo_x = std::max(lo_x, packed_min_cx_);
+    long long packed_hi_x = std::min(hi_x, packed_min_cx_+packed_width_-1);
+    long long packed_lo_y = std::max(lo_y, packed_min_cy_);
+    long long packed_hi_y = std::min(hi_y, packed_min_cy_+packed_height_-1);
+    if (packed_lo_x <= packed_hi_x)
+    {
+        constexpr long long ROWS_AT_ONCE = 4;
+        for (long long first_row = packed_lo_y; first_row <= packed_hi_y; first_row += ROWS_AT_ONCE)
+        {
+            long long last_row = std::min(first_row+ROWS_AT_ONCE-1, packed_hi_y);
+            for (long long cy = first_row; cy <= last_row; ++cy)
+            {
+                __builtin_prefetch(&cell_start_[packed_index_(packed_lo_x,cy)]);
+                __builtin_prefetch(&cell_start_[packed_index_(packed_hi_x,cy)+1]);
+            }
+            std::array<std::pair<std::uint32_t,std::uint32_t>,ROWS_AT_ONCE> ranges;
+            for (long long cy = first_row; cy <= last_row; ++cy)
+            {
+                auto& range = ranges[cy-first_row];
+                range = {cell_start_[packed_index_(packed_lo_x,cy)], cell_start_[packed_index_(packed_hi_x,cy)+1]};
+                if (range.first < range.second)
+                {
+                    __builtin_prefetch(&coords_[range.first]);
+                    __builtin_prefetch(&coords_[range.second-1]);
+                    __builtin_prefetch(&ids_[range.first]);
+                }
+            }
+            for (long long cy = first_row; cy <= last_row; ++cy)
+            {
+                auto const& range = ranges[cy-first_row];
+                visit_places_(ids_.data()+range.first,coords_.data()+range.first,range.second-range.first,xy,k,best);
+            }
+        }
+    }
+
+    if (overflow_size_ == 0)
+    {
+        return;
+    }
+    for (long long cy = lo_y; cy <= hi_y; ++cy)
+    {
+        for (long long cx = lo_x; cx <= hi_x; ++cx)
+        {
+            if (!is_packed_cell_(cx,cy) || has_overflow_[packed_index_(cx,cy)])
+            {
+                visit_cell_(cx,cy,xy,k,best);
+            }
+        }
+    }
+}
+
+void PlaceGrid::visit_cell_(long long cx, long long cy, Coord xy, std::size_t k, std::vector<Candidate> & best) const
+{
+    auto cellIt = overflow_.find(cell_key_(cx,cy));
+    if (cellIt != overflow_.end())
+    {
+        Cell const& cell = cellIt->second;
+        visit_places_(cell.ids.data(),cell.coords.data(),cell.ids.size(),xy,k,best);
+    }
+}
+
+void PlaceGrid::visit_places_(PlaceID const* ids, Coord const* coords, std::size_t count,
+                              Coord xy, std::size_t k, std::vector<Candidate> & best) const
+{
+    constexpr std::size_t BLOCK_SIZE = 64;
+    long long dists[BLOCK_SIZE];
+    for (std::size_t start = 0; start < count; start += BLOCK_SIZE)
+    {
+        std::size_t block_count = std::min(BLOCK_SIZE, count-start);
+        squared_distances(coords+start,block_count,xy,dists);
+        for (std::size_t i = 0; i < block_count; ++i)
+        {
+            // IDs are read only for places that get to the candidates, which keeps
+            // the scan on the coordinate array.
+            if (best.size() == k && dists[i] > std::get<0>(best.front()))
+            {
+                continue;
+            }
+            PlaceID id = ids[start+i];
+            if (id == NO_PLACE)
+            {
+                continue;
+            }
+            Candidate candidate{dists[i], coords[start+i].y, id};
+            if (best.size() < k)
+            {
+                best.push_back(candidate);
+                std::push_heap(best.begin(),best.end());
+            }
+            else if (candidate < best.front())
+            {
+                std::pop_heap(best.begin(),best.end());
+                best.back() = candidate;
+                std::push_heap(best.begin(),best.end());
+            }
+        }
+    }
+}
+
+void PlaceGrid::include_cell_(long long cx, long long cy)
+{
+    if (min_cx_ > max_cx_)
+    {
+        min_cx_ = max_cx_ = cx;
+        min_cy_ = max_cy_ = cy;
+        return;
+    }
+    min_cx_ = std::min(min_cx_, cx);
+    max_cx_ = std::max(max_cx_, cx);
+    min_cy_ = std::min(min_cy_, cy);
+    max_cy_ = std::max(max_cy_, cy);
+}
+
+void PlaceGrid::compact_if_needed_()
+{
+    // Searching overflow cells is slower than searching packed ones, so the grid is
+    // packed again if there have been many changes since the latest rebuild. This is
+    // amortized constant since it happens only after built_size_/16 changes.
+    if (16*(overflow_size_+removed_) > built_size_ + 256)
+    {
+        rebuild_();
+    }
+}
+
+void PlaceGrid::insert_all(std::vector<PlaceID> const& ids, std::vector<Coord> const& coords)
+{
+    std::vector<PlaceID> all_ids;
+    std::vector<Coord> all_coords;
+    all_ids.reserve(size_+ids.size());
+    all_coords.reserve(size_+ids.size());
+    collect_(all_ids,all_coords);
+    all_ids.insert(all_ids.end(),ids.begin(),ids.end());
+    all_coords.insert(all_coords.end(),coords.begin(),coords.end());
+    build_(all_ids,all_coords);
+}
+
+void PlaceGrid::collect_(std::vector<PlaceID> & ids, std::vector<Coord> & coords) const
+{
+    for (std::size_t i = 0; i < ids_.size(); ++i)
+    {
+        if (ids_[i] != NO_PLACE)
+        {
+            ids.push_back(ids_[i]);
+            coords.push_back(coords_[i]);
+        }
+    }
+    for (auto const& cell : overflow_)
+    {
+        ids.insert(ids.end(),cell.second.ids.begin(),cell.second.ids.end());
+        coords.insert(coords.end(),cell.second.coords.begin(),cell.second.coords.end());
+    }
+}
+
+void PlaceGrid::rebuild_()
+{
+    std::vector<PlaceID> ids;
+    std::vector<Coord> coords;
+    ids.reserve(size_);
+    coords.reserve(size_);
+    collect_(ids,coords);
+    build_(ids,coords);
+}
+
+void PlaceGrid::build_(std::vector<PlaceID> const& ids, std::vector<Coord> const& coords)
+{
+    *this = PlaceGrid();
+    size_ = built_size_ = ids.size();
+    if (ids.empty())
+    {
+        return;
+    }
+
+    Coord min = coords.front();
+    Coord max = coords.front();
+    for (Coord xy : coords)
+    {
+        min = {std::min(min.x,xy.x), std::min(min.y,xy.y)};
+        max = {std::max(max.x,xy.x), std::max(max.y,xy.y)};
+    }
+
+    // Choose the cell side so that there are about two places per cell.
+    double area = (static_cast<double>(max.x)-min.x+1) * (static_cast<double>(max.y)-min.y+1);
+    double wanted_side = std::sqrt(2.0*area/ids.size());
+    shift_ = 0;
+    while (shift_ < 30 && static_cast<double>(1LL << shift_) < wanted_side)
+    {
+        ++shift_;
+    }
+
+    packed_min_cx_ = min.x >> shift_;
+    packed_min_cy_ = min.y >> shift_;
+    packed_width_ = (max.x >> shift_) - packed_min_cx_ + 1;
+    packed_height_ = (max.y >> shift_) - packed_min_cy_ + 1;
+    min_cx_ = packed_min_cx_;
+    min_cy_ = packed_min_cy_;
+    max_cx_ = packed_min_cx_ + packed_width_ - 1;
+    max_cy_ = packed_min_cy_ + packed_height_ - 1;
+
+    // Counting sort of the places by their cell.
+    std::size_t cells = static_cast<std::size_t>(packed_width_*packed_height_);
+    cell_start_.assign(cells+1,0);
+    has_overflow_.assign(cells,false);
+    for (Coord xy : coords)
+    {
+        ++cell_start_[packed_index_(xy.x >> shift_, xy.y >> shift_)+1];
+    }
+    for (std::size_t i = 0; i < cells; ++i)
+    {
+        cell_start_[i+1] += cell_start_[i];
+    }
+    std::vector<std::uint32_t> next(cell_start_.begin(),cell_start_.end()-1);
+    ids_.resize(ids.size());
+    coords_.resize(ids.size());
+    for (std::size_t i = 0; i < ids.size(); ++i)
+    {
+        std::uint32_t to = next[packed_index_(coords[i].x >> shift_, coords[i].y >> shift_)]++;
+        ids_[to] = ids[i];
+        coords_[to] = coords[i];
+    }
+}
+
+void* MonotonicArena::allocate(std::size_t bytes, std::size_t alignment)
+{
+    std::size_t padding = (alignment - reinterpret_cast<std::uintptr_t>(position_) % alignment) % alignment;
+    if (padding + bytes > remaining_)
+    {
+        // A new block, at least large enough for this allocation. The space left
+        // in the previous block is not used anymore.
+        std::size_t block_size = std::max(next_block_size_, bytes+alignment);
+        blocks_.emplace_back(new char[block_size]);
+        position_ = blocks_.back().get();
+        remaining_ = block_size;
+        next_block_size_ = std::min(2*next_block_size_, MAX_BLOCK_SIZE);
+        padding = (alignment - reinterpret_cast<std::uintptr_t>(position_) % alignment) % alignment;
+    }
+    void* result = position_ + padding;
+    position_ += padding + bytes;
+    remaining_ -= padding + bytes;
+    return result;
+}
+
+void MonotonicArena::release()
+{
+    blocks_.clear();
+    position_ = nullptr;
+    remaining_ = 0;
+    next_block_size_ = FIRST_BLOCK_SIZE;
+}
+
+std::size_t MonotonicArena::block_count() const
+{
+    return blocks_.size();
+}
+
+// Zigzag encoding maps small negative and positive differences to small unsigned values.
+std::uint64_t zigzag(long long value)
+{
+    return (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63);
+}
+
+std::size_t varint_size(std::uint64_t value)
+{
+    std::size_t bytes = 1;
+    for (; value >= 0x80; value >>= 7)
+    {
+        ++bytes;
+    }
+    return bytes;
+}
+
+std::uint8_t* write_varint(std::uint64_t value, std::uint8_t* out)
+{
+    for (; value >= 0x80; value >>= 7)
+    {
+        *out++ = static_cast<std::uint8_t>(value | 0x80);
+    }
+    *out++ = static_cast<std::uint8_t>(value);
+    return out;
+}
+
+PackedShape PackedShape::encode(Coord const* coords, std::size_t count, MonotonicArena & arena)
+{
+    if (count == 0)
+    {
+        return {};
+    }
+    // Differences are taken with 64-bit integers, so that they cannot overflow.
+    std::size_t bytes = 0;
+    Coord previous = {0,0};
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        bytes += varint_size(zigzag(static_cast<long long>(coords[i].x)-previous.x));
+        bytes += varint_size(zigzag(static_cast<long long>(coords[i].y)-previous.y));
+        previous = coords[i];
+    }
+    std::uint8_t* data = static_cast<std::uint8_t*>(arena.allocate(bytes,1));
+    std::uint8_t* out = data;
+    previous = {0,0};
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        out = write_varint(zigzag(static_cast<long long>(coords[i].x)-previous.x),out);
+        out = write_varint(zigzag(static_cast<long long>(coords[i].y)-previous.y),out);
+        previous = coords[i];
+    }
+    return {data,static_cast<std::uint32_t>(count)};
+}
+
+void PackedShape::decode(Coord* out) const
+{
+    ShapeDecoder(*this).next(out,size_);
+}
+
+std::size_t ShapeDecoder::next(Coord* out, std::size_t max)
+{
+    std::size_t count = std::min(max,remaining_);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        out[i] = next();
+    }
+    return count;
+}
+
+namespace
+{
+
+char lower_case(char c)
+{
+    return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+}
+
+}
+
+std::size_t edit_distance(std::string_view a, std::string_view b, std::size_t limit)
+{
+    std::size_t length_difference = a.size() > b.size() ? a.size()-b.size() : b.size()-a.size();
+    if (length_difference > limit)
+    {
+        return limit+1; // needs at least length_difference insertions or deletions
+    }
+    limit = std::min(limit,std::max(a.size(),b.size())); // the distance is never more than this
+
+    // previous[j] and current[j]: distance between a[0..i) and b[0..j) for the previous and current i.
+    // Cells further than limit from the diagonal are more than limit and are kept at limit+1.
+    std::size_t const over = limit+1;
+    std::vector<std::size_t> previous(b.size()+1,over);
+    std::vector<std::size_t> current(b.size()+1,over);
+    for (std::size_t j = 0; j <= std::min(b.size(),limit); ++j)
+    {
+        previous[j] = j;
+    }
+    for (std::size_t i = 1; i <= a.size(); ++i)
+    {
+        std::size_t first = i > limit ? i-limit : 1;
+        std::size_t last = std::min(b.size(),i+limit);
+        current[first-1] = i <= limit ? i : over;
+        std::size_t row_minimum = current[first-1];
+        for (std::size_t j = first; j <= last; ++j)
+        {
+            std::size_t substitution = previous[j-1] + (lower_case(a[i-1]) == lower_case(b[j-1]) ? 0 : 1);
+            current[j] = std::min({previous[j]+1, current[j-1]+1, substitution, over});
+            row_minimum = std::min(row_minimum,current[j]);
+        }
+        if (last < b.size())
+        {
+            current[last+1] = over;
+        }
+        if (row_minimum > limit)
+        {
+            return over; // the distances only grow from row to row
+        }
+        std::swap(previous,current);
+    }
+    return previous[b.size()];
+}
+
+std::vector<std::uint32_t> TrigramIndex::trigrams(std::string_view name)
+{
+    std::string padded(1,'\0');
+    for (char c : name)
+    {
+        padded.push_back(lower_case(c));
+    }
+    padded.push_back('\0');
+
+    std::vector<std::uint32_t> result;
+    result.reserve(padded.size());
+    for (std::size_t i = 0; i+2 < padded.size(); ++i)
+    {
+        result.push_back(static_cast<std::uint32_t>(static_cast<unsigned char>(padded[i])) << 16 |
+                         static_cast<std::uint32_t>(static_cast<unsigned char>(padded[i+1])) << 8 |
+                         static_cast<std::uint32_t>(static_cast<unsigned char>(padded[i+2])));
+    }
+    std::sort(result.begin(),result.end());
+    result.erase(std::unique(result.begin(),result.end()),result.end());
+    return result;
+}
+
+void TrigramIndex::insert(NameHandle handle, std::string_view name)
+{
+    for (std::uint32_t trigram : trigrams(name))
+    {
+        // The lists are kept sorted. New handles are the largest ones, so they
+        // are added to the end, only reused handles have to be inserted in the middle.
+        std::vector<NameHandle>& handles = handles_by_trigram_[trigram];
+        handles.insert(std::lower_bound(handles.begin(),handles.end(),handle),handle);
+    }
+}
+
+void TrigramIndex::erase(NameHandle handle, std::string_view name)
+{
+    for (std::uint32_t trigram : trigrams(name))
+    {
+        auto listIt = handles_by_trigram_.find(trigram);
+        if (listIt == handles_by_trigram_.end())
+        {
+            continue;
+        }
+        std::vector<NameHandle>& handles = listIt->second;
+        auto position = std::lower_bound(handles.begin(),handles.end(),handle);
+        if (position != handles.end() && *position == handle)
+        {
+            handles.erase(position);
+        }
+        if (handles.empty())
+        {
+            handles_by_trigram_.erase(trigram);
+        }
+    }
+}
+
+void TrigramIndex::clear()
+{
+    handles_by_trigram_.clear();
+}
+
+std::vector<NameHandle> TrigramIndex::candidates(std::string_view query, std::size_t min_shared) const
+{
+    std::vector<std::vector<NameHandle> const*> lists;
+    std::size_t missing = 0; // trigrams that no name has
+    for (std::uint32_t trigram : trigrams(query))
+    {
+        auto listIt = handles_by_trigram_.find(trigram);
+        if (listIt == handles_by_trigram_.end())
+        {
+            ++missing;
+        }
+        else
+        {
+            lists.push_back(&listIt->second);
+        }
+    }
+    min_shared = std::max<std::size_t>(min_shared,1);
+    if (lists.empty() || lists.size()+missing < min_shared)
+    {
+        return {};
+    }
+
+    // The missing trigrams are the shortest lists (empty), so fewer real lists are needed.
+    std::size_t needed = lists.size()+missing-min_shared+1;
+    if (needed <= missing)
+    {
+        return {};
+    }
+    needed = std::min(needed-missing,lists.size());
+    std::sort(lists.begin(),lists.end(),[](auto a, auto b){ return a->size() < b->size(); });
+
+    // The shortest lists are merged (they are sorted by handle) to (handle, number of those
+    // lists having it). A handle is at most once in a list, so the number of lists having
+    // it is the number of shared trigrams.
+    std::vector<std::pair<NameHandle const*,NameHandle const*>> heads;
+    for (std::size_t i = 0; i < needed; ++i)
+    {
+        heads.emplace_back(lists[i]->data(),lists[i]->data()+lists[i]->size());
+    }
+    std::vector<std::pair<NameHandle,std::size_t>> shared;
+    while (true)
+    {
+        NameHandle smallest = NO_NAME_HANDLE;
+        for (auto const& head : heads)
+        {
+            if (head.first != head.second)
+            {
+                smallest = std::min(smallest,*head.first);
+            }
+        }
+        if (smallest == NO_NAME_HANDLE)
+        {
+            break;
+        }
+        std::size_t count = 0;
+        for (auto& head : heads)
+        {
+            if (head.first != head.second && *head.first == smallest)
+            {
+                ++head.first;
+                ++count;
+            }
+        }
+        shared.emplace_back(smallest,count);
+    }
+
+    // The longer lists are only searched for the handles found above. Both are sorted, so
+    // the search continues from the previous position, with steps that grow exponentially
+    // (galloping) until the handle is passed, and binary search after that.
+    for (std::size_t i = needed; i < lists.size(); ++i)
+    {
+        auto position = lists[i]->begin();
+        auto end = lists[i]->end();
+        for (auto& handle : shared)
+        {
+            std::size_t step = 1;
+            while (step < static_cast<std::size_t>(end-position) && position[step] < handle.first)
+            {
+                step *= 2;
+            }
+            position = std::lower_bound(position+step/2,position+std::min<std::size_t>(step+1,end-position),handle.first);
+            if (position == end)
+            {
+                break;
+            }
+            if (*position == handle.first)
+            {
+                ++handle.second;
+            }
+        }
+    }
+
+    std::vector<NameHandle> result;
+    for (auto const& handle : shared)
+    {
+        if (handle.second >= min_shared)
+        {
+            result.push_back(handle.first);
+        }
+    }
+    return result;
+}
+
+NameHandle NamePool::intern(Name const& name, bool defer_trigrams)
+{
+    auto handleIt = handles_.find(name);
+    if (handleIt != handles_.end())
+    {
+        ++reference_counts_[handleIt->second];
+        return handleIt->second;
+    }
+    Span<char const> characters = arena_.copy(name.data(),name.size());
+    std::string_view stored(characters.data(),characters.size());
+    NameHandle handle;
+    if (free_handles_.empty())
+    {
+        handle = static_cast<NameHandle>(names_.size());
+        names_.push_back(stored);
+        reference_counts_.push_back(1);
+    }
+    else
+    {
+        handle = free_handles_.back();
+        free_handles_.pop_back();
+        names_[handle] = stored;
+        reference_counts_[handle] = 1;
+    }
+    handles_.insert({stored,handle});
+    if (defer_trigrams)
+    {
+        deferred_trigrams_.push_back(handle);
+    }
+    else
+    {
+        trigrams_.insert(handle,stored);
+    }
+    return handle;
+}
+
+void NamePool::index_deferred_trigrams()
+{
+    for (NameHandle handle : deferred_trigrams_)
+    {
+        if (reference_counts_[handle] > 0)
+        {
+            trigrams_.insert(handle,names_[handle]);
+        }
+    }
+    deferred_trigrams_.clear();
+}
+
+void NamePool::release(NameHandle handle)
+{
+    if (--reference_counts_[handle] > 0)
+    {
+        return;
+    }
+    handles_.erase(names_[handle]);
+    trigrams_.erase(handle,names_[handle]);
+    names_[handle] = {};
+    free_handles_.push_back(handle);
+}
+
+NameHandle NamePool::find(Name const& name) const
+{
+    auto handleIt = handles_.find(name);
+    if (handleIt == handles_.end())
+    {
+        return NO_NAME_HANDLE;
+    }
+    return handleIt->second;
+}
+
+std::string_view NamePool::name(NameHandle handle) const
+{
+    return names_[handle];
+}
+
+std::size_t NamePool::handle_count() const
+{
+    return names_.size();
+}
+
+TrigramIndex const& NamePool::trigrams() const
+{
+    return trigrams_;
+}
+
+void NamePool::clear()
+{
+    trigrams_.clear();
+    deferred_trigrams_.clear();
+    names_.clear();
+    reference_counts_.clear();
+    free_handles_.clear();
+    handles_.clear();
+    arena_.release();
+}
+
+std::size_t PlaceStore::size() const
+{
+    return ids.size();
+}
+
+std::size_t PlaceStore::find(PlaceID id) const
+{
+    auto slotIt = slots_.find(id);
+    if (slotIt == slots_.end())
+    {
+        return NO_SLOT;
+    }
+    return slotIt->second;
+}
+
+std::size_t PlaceStore::add(PlaceID id, NameHandle name, PlaceType type, Coord xy)
+{
+    std::size_t slot = ids.size();
+    if (!slots_.insert({id,slot}).second)
+    {
+        return NO_SLOT;
+    }
+    ids.push_back(id);
+    xs.push_back(xy.x);
+    ys.push_back(xy.y);
+    types.push_back(type);
+    names.push_back(name);
+    type_bucket_indexes.push_back(0);
+    return slot;
+}
+
+void PlaceStore::reserve(std::size_t count)
+{
+    ids.reserve(count);
+    xs.reserve(count);
+    ys.reserve(count);
+    types.reserve(count);
+    names.reserve(count);
+    type_bucket_indexes.reserve(count);
+    slots_.reserve(count);
+}
+
+void PlaceStore::remove(std::size_t slot)
+{
+    // The last place is moved to the removed slot, so the arrays stay dense
+    // and only one entry of slots_ changes.
+    std::size_t last = ids.size()-1;
+    slots_.erase(ids[slot]);
+    if (slot != last)
+    {
+        ids[slot] = ids[last];
+        xs[slot] = xs[last];
+        ys[slot] = ys[last];
+        types[slot] = types[last];
+        names[slot] = names[last];
+        type_bucket_indexes[slot] = type_bucket_indexes[last];
+        slots_[ids[slot]] = slot;
+    }
+    ids.pop_back();
+    xs.pop_back();
+    ys.pop_back();
+    types.pop_back();
+    names.pop_back();
+    type_bucket_indexes.pop_back();
+}
+
+void PlaceStore::clear()
+{
+    *this = PlaceStore();
+}
+
+Coord PlaceStore::coord(std::size_t slot) const
+{
+    return {xs[slot], ys[slot]};
+}
+
+void PlaceStore::set_coord(std::size_t slot, Coord xy)
+{
+    xs[slot] = xy.x;
+    ys[slot] = xy.y;
+}
+
+void WayGraph::build(HashMap<Coord,Node,CoordHash> const& nodes, HashMap<WayID,Way> const& ways)
+{
+    clear();
+    way_ids.reserve(ways.size());
+    for (auto const& way : ways)
+    {
+        way_ids.push_back(way.first);
+    }
+    std::sort(way_ids.begin(),way_ids.end());
+
+    coords.reserve(nodes.size());
+    sorted_coords_.reserve(nodes.size());
+    for (auto const& node : nodes)
+    {
+        sorted_coords_.push_back({node.first,static_cast<std::uint32_t>(coords.size())});
+        coords.push_back(node.first);
+    }
+    std::sort(sorted_coords_.begin(),sorted_coords_.end());
+
+    edge_start.reserve(coords.size()+1);
+    edge_start.push_back(0);
+    for (auto const& node : nodes)
+    {
+        for (auto const& access : node.second.accesses)
+        {
+            std::uint32_t way = static_cast<std::uint32_t>(
+                        std::lower_bound(way_ids.begin(),way_ids.end(),access.second) - way_ids.begin());
+            edge_to.push_back(find(access.first));
+            edge_way.push_back(way);
+            edge_distance.push_back(ways.at(access.second).distance);
+        }
+        edge_start.push_back(static_cast<std::uint32_t>(edge_to.size()));
+    }
+}
+
+void WayGraph::clear()
+{
+    *this = WayGraph();
+}
+
+std::size_t WayGraph::node_count() const
+{
+    return coords.size();
+}
+
+std::uint32_t WayGraph::find(Coord xy) const
+{
+    auto position = std::lower_bound(sorted_coords_.begin(),sorted_coords_.end(),xy,
+                                     [](std::pair<Coord,std::uint32_t> const& a, Coord b) { return a.first < b; });
+    if (position == sorted_coords_.end() || position->first != xy)
+    {
+        return NO_NODE;
+    }
+    return position->second;
+}
+
+bool AreaForest::build(HashMap<AreaID,Area,IdHash> const& areas)
+{
+    clear();
+    nodes_.reserve(areas.size());
+    links_.reserve(areas.size());
+    ids_.reserve(areas.size());
+    index_of_.reserve(areas.size());
+    // The areas get their indexes in preorder, so that the upper areas and the subareas of
+    // an area are near each other in the arrays until the hierarchy is changed. Areas in a
+    // cycle of subareas are not under any top-level area, and they are added after the rest.
+    std::vector<std::pair<std::vector<AreaID> const*,std::size_t>> stack;
+    for (auto const& area : areas)
+    {
+        if (area.second.parentAreaID != NO_AREA)
+        {
+            continue;
+        }
+        add(area.first);
+        stack.push_back({&area.second.childrenAreas,0});
+        while (!stack.empty())
+        {
+            auto& [children, next_child] = stack.back();
+            if (next_child == children->size())
+            {
+                stack.pop_back();
+                continue;
+            }
+            AreaID subarea = (*children)[next_child++];
+            add(subarea);
+            stack.push_back({&areas.find(subarea)->second.childrenAreas,0}); // invalidates children
+        }
+    }
+    for (auto const& area : areas)
+    {
+        if (find(area.first) == NO_INDEX)
+        {
+            add(area.first);
+        }
+    }
+    // The subareas are linked in their order in childrenAreas, so that links_ lists them
+    // in the same order. A subarea is still a root when it is linked, so the link would
+    // close a cycle exactly when the parent is in the tree of the subarea.
+    bool acyclic = true;
+    for (auto const& area : areas)
+    {
+        if (area.second.childrenAreas.empty())
+        {
+            continue;
+        }
+        std::uint32_t parent_index = find(area.first);
+        for (AreaID subarea : area.second.childrenAreas)
+        {
+            std::uint32_t child = find(subarea);
+            if (root_of(parent_index) == child)
+            {
+                acyclic = false;
+                continue;
+            }
+            link(child,parent_index);
+        }
+    }
+    return acyclic;
+}
+
+void AreaForest::clear()
+{
+    *this = AreaForest();
+}
+
+std::uint32_t AreaForest::find(AreaID id) const
+{
+    auto position = index_of_.find(id);
+    if (position == index_of_.end())
+    {
+        return NO_INDEX;
+    }
+    return position->second;
+}
+
+std::uint32_t AreaForest::add(AreaID id)
+{
+    std::uint32_t index;
+    if (!free_indexes_.empty())
+    {
+        index = free_indexes_.back();
+        free_indexes_.pop_back();
+        ids_[index] = id;
+    }
+    else
+    {
+        index = static_cast<std::uint32_t>(nodes_.size());
+        nodes_.push_back({});
+        links_.push_back({});
+        ids_.push_back(id);
+    }
+    nodes_[index] = {NO_INDEX,NO_INDEX,NO_INDEX,1,1,0};
+    links_[index] = {NO_INDEX,NO_INDEX,NO_INDEX,NO_INDEX,NO_INDEX};
+    index_of_.insert({id,index});
+    return index;
+}
+
+void AreaForest::remove(std::uint32_t index)
+{
+    cut(index);
+    index_of_.erase(ids_[index]);
+    free_indexes_.push_back(index);
+}
+
+void AreaForest::link(std::uint32_t child, std::uint32_t parent_index)
+{
+    access_(child);
+    access_(parent_index);
+    nodes_[child].parent = parent_index;
+    nodes_[parent_index].virtual_size += nodes_[child].size;
+    update_(parent_index);
+
+    Links& parent_links = links_[parent_index];
+    links_[child] = {parent_index,links_[child].first_child,links_[child].last_child,parent_links.last_child,NO_INDEX};
+    if (parent_links.last_child != NO_INDEX)
+    {
+        links_[parent_links.last_child].next_sibling = child;
+    }
+    else
+    {
+        parent_links.first_child = child;
+    }
+    parent_links.last_child = child;
+}
+
+void AreaForest::cut(std::uint32_t child)
+{
+    access_(child);
+    std::uint32_t upper = nodes_[child].left;
+    if (upper == NO_INDEX)
+    {
+        return;
+    }
+    nodes_[upper].parent = NO_INDEX;
+    nodes_[child].left = NO_INDEX;
+    update_(child);
+
+    Links& child_links = links_[child];
+    Links& parent_links = links_[child_links.parent];
+    if (child_links.previous_sibling != NO_INDEX)
+    {
+        links_[child_links.previous_sibling].next_sibling = child_links.next_sibling;
+    }
+    else
+    {
+        parent_links.first_child = child_links.next_sibling;
+    }
+    if (child_links.next_sibling != NO_INDEX)
+    {
+        links_[child_links.next_sibling].previous_sibling = child_links.previous_sibling;
+    }
+    else
+    {
+        parent_links.last_child = child_links.previous_sibling;
+    }
+    child_links.parent = NO_INDEX;
+    child_links.previous_sibling = NO_INDEX;
+    child_links.next_sibling = NO_INDEX;
+}
+
+std::uint32_t AreaForest::root_of(std::uint32_t index)
+{
+    access_(index);
+    while (nodes_[index].left != NO_INDEX)
+    {
+        index = nodes_[index].left;
+    }
+    splay_(index);
+    return index;
+}
+
+std::uint32_t AreaForest::common_ancestor(std::uint32_t index1, std::uint32_t index2)
+{
+    if (index1 == index2)
+    {
+        return index1;
+    }
+    if (root_of(index1) != root_of(index2))
+    {
+        return NO_INDEX;
+    }
+    access_(index1);
+    return access_(index2);
+}
+
+bool AreaForest::contains(std::uint32_t outer, std::uint32_t inner)
+{
+    return outer != inner && common_ancestor(outer,inner) == outer;
+}
+
+void AreaForest::upper_areas(std::uint32_t index, std::vector<AreaID> & result)
+{
+    access_(index);
+    std::uint32_t upper = nodes_[index].left;
+    std::size_t position = result.size();
+    result.resize(position+(upper == NO_INDEX ? 0 : nodes_[upper].path_count));
+    for (; position < result.size(); ++position)
+    {
+        index = links_[index].parent;
+        result[position] = ids_[index];
+    }
+}
+
+void AreaForest::subareas(std::uint32_t index, std::vector<AreaID> & result)
+{
+    access_(index);
+    std::size_t position = result.size();
+    result.resize(position+nodes_[index].virtual_size);
+    // Preorder: down to the first subarea if there is one, otherwise to the next sibling of
+    // the area or of the nearest upper area that has one, but not above index.
+    std::uint32_t current = links_[index].first_child;
+    while (current != NO_INDEX)
+    {
+        result[position++] = ids_[current];
+        if (links_[current].first_child != NO_INDEX)
+        {
+            current = links_[current].first_child;
+            continue;
+        }
+        while (current != index && links_[current].next_sibling == NO_INDEX)
+        {
+            current = links_[current].parent;
+        }
+        current = current == index ? NO_INDEX : links_[current].next_sibling;
+    }
+}
+
+bool AreaForest::is_splay_root_(std::uint32_t index) const
+{
+    std::uint32_t parent_index = nodes_[index].parent;
+    return parent_index == NO_INDEX ||
+           (nodes_[parent_index].left != index && nodes_[parent_index].right != index);
+}
+
+void AreaForest::update_(std::uint32_t index)
+{
+    Node& node = nodes_[index];
+    node.path_count = 1;
+    node.size = 1+node.virtual_size;
+    for (std::uint32_t child : {node.left,node.right})
+    {
+        if (child != NO_INDEX)
+        {
+            node.path_count += nodes_[child].path_count;
+            node.size += nodes_[child].size;
+        }
+    }
+}
+
+void AreaForest::rotate_(std::uint32_t index)
+{
+    std::uint32_t parent_index = nodes_[index].parent;
+    std::uint32_t grandparent = nodes_[parent_index].parent;
+    bool parent_was_root = is_splay_root_(parent_index);
+    std::uint32_t moved; // the subtree of index that changes sides
+    if (nodes_[parent_index].left == index)
+    {
+        moved = nodes_[index].right;
+        nodes_[parent_index].left = moved;
+        nodes_[index].right = parent_index;
+    }
+    else
+    {
+        moved = nodes_[index].left;
+        nodes_[parent_index].right = moved;
+        nodes_[index].left = parent_index;
+    }
+    if (moved != NO_INDEX)
+    {
+        nodes_[moved].parent = parent_index;
+    }
+    nodes_[parent_index].parent = index;
+    nodes_[index].parent = grandparent; // also keeps the path-parent of the splay tree
+    if (!parent_was_root)
+    {
+        if (nodes_[grandparent].left == parent_index)
+        {
+            nodes_[grandparent].left = index;
+        }
+        else
+        {
+            nodes_[grandparent].right = index;
+        }
+    }
+    update_(parent_index);
+    update_(index);
+}
+
+void AreaForest::splay_(std::uint32_t index)
+{
+    while (!is_splay_root_(index))
+    {
+        std::uint32_t parent_index = nodes_[index].parent;
+        if (!is_splay_root_(parent_index))
+        {
+            std::uint32_t grandparent = nodes_[parent_index].parent;
+            bool same_side = (nodes_[grandparent].left == parent_index) == (nodes_[parent_index].left == index);
+            rotate_(same_side ? parent_index : index);
+        }
+        rotate_(index);
+    }
+}
+
+std::uint32_t AreaForest::access_(std::uint32_t index)
+{
+    // Climbs the path-parents from index, and every path is cut below the area where
+    // the climb entered it and joined to the path below, so that the path from the root
+    // to index becomes one splay tree with no areas below index. The part that is cut
+    // off hangs below by its path-parent from then on, so it moves to virtual_size.
+    std::uint32_t last = NO_INDEX;
+    for (std::uint32_t upper = index; upper != NO_INDEX; upper = nodes_[upper].parent)
+    {
+        splay_(upper);
+        Node& node = nodes_[upper];
+        if (node.right != NO_INDEX)
+        {
+            node.virtual_size += nodes_[node.right].size;
+        }
+        if (last != NO_INDEX)
+        {
+            node.virtual_size -= nodes_[last].size;
+        }
+        node.right = last;
+        update_(upper);
+        last = upper;
+    }
+    splay_(index);
+    return last;
+}
+
+void AreaRTree::build(HashMap<AreaID,Area,IdHash> const& areas)
+{
+    clear();
+    std::vector<Box> boxes;
+    std::vector<Leaf> leaves;
+    boxes.reserve(areas.size());
+    leaves.reserve(areas.size());
+    for (auto const& area : areas)
+    {
+        Area const& data = area.second;
+        if (data.shape.empty())
+        {
+            continue;
+        }
+        boxes.push_back({data.boxMin,data.boxMax});
+        long long doubled_size = data.doubledSignedSize;
+        leaves.push_back({area.first,data.shape,doubled_size < 0 ? -doubled_size : doubled_size});
+    }
+    if (boxes.empty())
+    {
+        return;
+    }
+
+    std::vector<std::uint32_t> order;
+    str_order_(boxes,order);
+    leaf_boxes_.reserve(boxes.size());
+    leaves_.reserve(boxes.size());
+    for (std::uint32_t index : order)
+    {
+        leaf_boxes_.push_back(boxes[index]);
+        leaves_.push_back(leaves[index]);
+    }
+
+    // Every NODE_SIZE consecutive boxes of a level get one parent, and the parents are
+    // ordered the same way before they are packed into the next level.
+    boxes = leaf_boxes_;
+    std::size_t first_child = 0;
+    while (true)
+    {
+        std::vector<Node> level;
+        for (std::size_t first = 0; first < boxes.size(); first += NODE_SIZE)
+        {
+            std::size_t count = std::min(NODE_SIZE,boxes.size()-first);
+            Box box = boxes[first];
+            for (std::size_t i = first+1; i < first+count; ++i)
+            {
+                box.min = {std::min(box.min.x,boxes[i].min.x),std::min(box.min.y,boxes[i].min.y)};
+                box.max = {std::max(box.max.x,boxes[i].max.x),std::max(box.max.y,boxes[i].max.y)};
+            }
+            level.push_back({box,static_cast<std::uint32_t>(first_child+first),static_cast<std::uint32_t>(count)});
+        }
+        boxes.clear();
+        for (Node const& node : level)
+        {
+            boxes.push_back(node.box);
+        }
+        if (level.size() > 1)
+        {
+            str_order_(boxes,order);
+            std::vector<Box> ordered_boxes;
+            ordered_boxes.reserve(boxes.size());
+            first_child = nodes_.size();
+            for (std::uint32_t index : order)
+            {
+                nodes_.push_back(level[index]);
+                ordered_boxes.push_back(boxes[index]);
+            }
+            boxes.swap(ordered_boxes);
+        }
+        else
+        {
+            nodes_.push_back(level.front());
+        }
+        if (leaf_parents_ == 0)
+        {
+            leaf_parents_ = nodes_.size();
+        }
+        if (level.size() == 1)
+        {
+            break;
+        }
+    }
+}
+
+void AreaRTree::clear()
 {
-    auto range = end-start;
-    ++range;
+    *this = AreaRTree();
+}
 
-    auto num = std::uniform_int_distribution<unsigned long int>(0, range-1)(rand_engine);
+void AreaRTree::find(Coord xy, std::vector<std::pair<long long,AreaID>> & found) const
+{
+    if (nodes_.empty() || !contains_(nodes_.back().box,xy))
+    {
+        return;
+    }
+    std::vector<std::uint32_t> stack = {static_cast<std::uint32_t>(nodes_.size()-1)};
+    while (!stack.empty())
+    {
+        std::uint32_t index = stack.back();
+        stack.pop_back();
+        Node const& node = nodes_[index];
+        if (index < leaf_parents_)
+        {
+            for (std::uint32_t child = node.first; child < node.first+node.count; ++child)
+            {
+                Leaf const& leaf = leaves_[child];
+                if (contains_(leaf_boxes_[child],xy) && point_in_polygon(leaf.shape,xy))
+                {
+                    found.push_back({leaf.doubled_size,leaf.id});
+                }
+            }
+            continue;
+        }
+        for (std::uint32_t child = node.first; child < node.first+node.count; ++child)
+        {
+            if (contains_(nodes_[child].box,xy))
+            {
+                stack.push_back(child);
+            }
+        }
+    }
+}
 
-    return static_cast<Type>(start+num);
+void AreaRTree::find_boxes_containing(Coord min, Coord max, std::vector<std::pair<long long,AreaID>> & found) const
+{
+    if (nodes_.empty() || !contains_(nodes_.back().box,min,max))
+    {
+        return;
+    }
+    std::vector<std::uint32_t> stack = {static_cast<std::uint32_t>(nodes_.size()-1)};
+    while (!stack.empty())
+    {
+        std::uint32_t index = stack.back();
+        stack.pop_back();
+        Node const& node = nodes_[index];
+        if (index < leaf_parents_)
+        {
+            for (std::uint32_t child = node.first; child < node.first+node.count; ++child)
+            {
+                if (contains_(leaf_boxes_[child],min,max))
+                {
+                    found.push_back({leaves_[child].doubled_size,leaves_[child].id});
+                }
+            }
+            continue;
+        }
+        for (std::uint32_t child = node.first; child < node.first+node.count; ++child)
+        {
+            if (contains_(nodes_[child].box,min,max))
+            {
+                stack.push_back(child);
+            }
+        }
+    }
+}
+
+bool AreaRTree::contains_(Box const& box, Coord xy)
+{
+    return box.min.x <= xy.x && xy.x <= box.max.x && box.min.y <= xy.y && xy.y <= box.max.y;
+}
+
+bool AreaRTree::contains_(Box const& box, Coord min, Coord max)
+{
+    return box.min.x <= min.x && max.x <= box.max.x && box.min.y <= min.y && max.y <= box.max.y;
+}
+
+void AreaRTree::str_order_(std::vector<Box> const& boxes, std::vector<std::uint32_t> & order)
+{
+    order.resize(boxes.size());
+    for (std::uint32_t index = 0; index < order.size(); ++index)
+    {
+        order[index] = index;
+    }
+    // Centers are compared doubled, so that they stay integers.
+    auto by_center_x = [&boxes](std::uint32_t a, std::uint32_t b)
+    {
+        long long center_a = static_cast<long long>(boxes[a].min.x)+boxes[a].max.x;
+        long long center_b = static_cast<long long>(boxes[b].min.x)+boxes[b].max.x;
+        return center_a < center_b || (center_a == center_b && a < b);
+    };
+    auto by_center_y = [&boxes](std::uint32_t a, std::uint32_t b)
+    {
+        long long center_a = static_cast<long long>(boxes[a].min.y)+boxes[a].max.y;
+        long long center_b = static_cast<long long>(boxes[b].min.y)+boxes[b].max.y;
+        return center_a < center_b || (center_a == center_b && a < b);
+    };
+    std::sort(order.begin(),order.end(),by_center_x);
+    // sqrt(parents) slices of sqrt(parents)*NODE_SIZE boxes, so that the parents are about square.
+    std::size_t parents = (boxes.size()+NODE_SIZE-1)/NODE_SIZE;
+    std::size_t slice_size = static_cast<std::size_t>(std::ceil(std::sqrt(static_cast<double>(parents))))*NODE_SIZE;
+    for (std::size_t first = 0; first < order.size(); first += slice_size)
+    {
+        std::sort(order.begin()+first,order.begin()+std::min(first+slice_size,order.size()),by_center_y);
+    }
 }
 
 // Modify the code below to implement the functionality of the class.
@@ -42,73 +1994,161 @@ int Datastructures::place_count()
 void Datastructures::clear_all()
 {
     places_.clear();
+    places_by_name_.clear();
+    for (auto& bucket : places_by_type_)
+    {
+        bucket.clear();
+    }
+    places_in_alphabetical_order_.clear();
+    alphabetical_order_cache_.clear();
+    alphabetical_order_cache_valid_ = true; // empty cache is valid for empty places_
+    places_in_coord_order_.clear();
+    coord_order_cache_.clear();
+    coord_order_cache_valid_ = true;
+    for (auto& grid : place_grids_)
+    {
+        grid.clear();
+    }
     areas_.clear();
+    areas_arena_.release(); // all shapes at once
+    area_forest_.clear();
+    area_forest_valid_ = false;
+    area_rtree_.clear();
+    area_rtree_valid_ = false;
+    name_pool_.clear();
     clear_ways();
+    indexes_deferred_ = false;
+    deferred_places_ = 0;
 }
 
 std::vector<PlaceID> Datastructures::all_places()
 {
-    std::vector<PlaceID> placeIDs;
-    for(auto place : places_)
-    {
-        placeIDs.push_back(place.first); // push_back() is constant on complexity.
-    }
-    return placeIDs;
+    return places_.ids; // the IDs are already in one continuous array.
 }
 
 bool Datastructures::add_place(PlaceID id, const Name& name, PlaceType type, Coord xy)
 {
-    Place newPlace = {name, type, xy};
-    auto result = places_.insert(std::make_pair(id,newPlace)); // insert() complexity: average theta(1), worst-case: O(n).
-                                                               // make_pair() complexity: constant. (theta(1)).
+    build_deferred_indexes_();
+    std::size_t slot = places_.add(id,NO_NAME_HANDLE,type,xy); // amortized constant on average.
+
+    // if places_ already include a place with same PlaceID, add() does not add anything to places_.
+    bool added = slot != PlaceStore::NO_SLOT;
+    if (added)
+    {
+        NameHandle handle = name_pool_.intern(name); // average constant.
+        places_.names[slot] = handle;
+        index_place_name_(id,handle); // average theta(1), worst-case: O(n).
+        add_to_type_bucket_(slot); // amortized constant.
+        places_in_alphabetical_order_.insert({handle,id}); // .insert() for set: O(log n).
+        alphabetical_order_cache_valid_ = false;
+        places_in_coord_order_.insert(coord_order_key_(id,xy)); // O(log n).
+        coord_order_cache_valid_ = false;
+        place_grids_[static_cast<std::size_t>(type)].insert(id,xy); // amortized constant on average.
+        place_grids_[static_cast<std::size_t>(PlaceType::NO_TYPE)].insert(id,xy);
+    }
 
-    // if places_ already include an element with same key (PlaceID), insert() does not add anything to places_.
+    return added;
+}
 
-    return result.second; // result.second is now a bool value which tells whether the insertion above was successfull or not.
+std::size_t Datastructures::add_places_bulk(std::vector<std::tuple<PlaceID, Name, PlaceType, Coord>> const& places)
+{
+    places_.reserve(places_.size()+places.size());
+    std::size_t added = 0;
+    for (auto const& [id, name, type, xy] : places)
+    {
+        std::size_t slot = places_.add(id,NO_NAME_HANDLE,type,xy);
+        if (slot != PlaceStore::NO_SLOT)
+        {
+            places_.names[slot] = name_pool_.intern(name,true);
+            ++added;
+        }
+    }
+    // The new places are the last ones of places_, they are indexed by build_deferred_indexes_.
+    deferred_places_ += added;
+    indexes_deferred_ = true;
+    return added;
 }
 
 std::pair<Name, PlaceType> Datastructures::get_place_name_type(PlaceID id)
 {
-    std::unordered_map<PlaceID,Place>::const_iterator placeIt = places_.find(id); // Complexity of find(): Average: constant ( Theta(1))
-                                                                                  // Worst case: Linear. O(n)
-    if (placeIt == places_.end())
+    std::size_t slot = places_.find(id); // Complexity of find(): Average: constant ( Theta(1))
+                                         // Worst case: Linear. O(n)
+    if (slot == PlaceStore::NO_SLOT)
     {
         return {NO_NAME, PlaceType::NO_TYPE};
     }
 
-    return std::make_pair(places_.at(id).placeName,places_.at(id).type); // .at() complexity: average constant, worst-case: O(n).
+    return std::make_pair(Name(name_pool_.name(places_.names[slot])),places_.types[slot]);
 }
 
 Coord Datastructures::get_place_coord(PlaceID id)
 {
-    std::unordered_map<PlaceID,Place>::const_iterator placeIt = places_.find(id); // Complexity of find(): Average: constant ( Theta(1))
-                                                                                  // Worst case: Linear. O(n).
-    if (placeIt == places_.end())
+    std::size_t slot = places_.find(id); // Complexity of find(): Average: constant ( Theta(1))
+                                         // Worst case: Linear. O(n).
+    if (slot == PlaceStore::NO_SLOT)
     {
         return NO_COORD;
     }
 
-    return places_.at(id).location; // .at() complexity: average constant (Theta(1)), worst-case: O(n).
+    return places_.coord(slot);
 }
 
 bool Datastructures::add_area(AreaID id, const Name &name, std::vector<Coord> coords)
 {
-    Area new_area = {name,coords,false,NO_AREA,{}}; // NO_AREA and empty vector {} indicates that no parent area are added yet and
-                                                    // that no subareas are added yet. bool-value tells is the are child of some area
-                                                    // which is false at initialization.
-
-    auto result = areas_.insert(std::make_pair(id,new_area)); // insert() complexity: average theta(1), worst-case: O(n).
-                                                              // make_pair() complexity: constant. (theta(1)).
+    // if areas_ already include an element with same key (AreaID), nothing is added.
+    if (areas_.find(id) != areas_.end()) // find() complexity: average theta(1), worst-case: O(n).
+    {
+        return false;
+    }
+    Area new_area = {name_pool_.intern(name),PackedShape::encode(coords.data(),coords.size(),areas_arena_),
+                     NO_COORD,NO_COORD,0,NO_COORD,false,NO_AREA,{}}; // NO_AREA and empty vector {} indicates that no parent area are added yet and
+                                                                                 // that no subareas are added yet. bool-value tells is the are child of some area
+                                                                                 // which is false at initialization.
+    measure_shape_(coords,new_area);
+
+    areas_.insert(std::make_pair(id,std::move(new_area))); // insert() complexity: average theta(1), worst-case: O(n).
+                                                           // make_pair() complexity: constant. (theta(1)).
+    if (area_forest_valid_ && area_forest_usable_)
+    {
+        area_forest_.add(id);
+    }
+    area_rtree_valid_ = false;
+    return true;
+}
 
-    // if areas_ already include an element with same key (AreaID), insert() does not add anything to areas_.
-    return result.second; // result.second is now a bool value which tells whether the insertion above was successfull or not.
+std::size_t Datastructures::add_areas_bulk(std::vector<std::tuple<AreaID, Name, std::vector<Coord>>> const& areas)
+{
+    areas_.reserve(areas_.size()+areas.size());
+    std::size_t added = 0;
+    for (auto const& [id, name, coords] : areas)
+    {
+        if (areas_.find(id) != areas_.end())
+        {
+            continue;
+        }
+        Area new_area = {name_pool_.intern(name,true),PackedShape::encode(coords.data(),coords.size(),areas_arena_),
+                         NO_COORD,NO_COORD,0,NO_COORD,false,NO_AREA,{}};
+        measure_shape_(coords,new_area);
+        areas_.insert(std::make_pair(id,std::move(new_area)));
+        if (area_forest_valid_ && area_forest_usable_)
+        {
+            area_forest_.add(id);
+        }
+        ++added;
+    }
+    indexes_deferred_ = true; // for the trigrams of the names
+    if (added > 0)
+    {
+        area_rtree_valid_ = false;
+    }
+    return added;
 }
 
 Name Datastructures::get_area_name(AreaID id)
 {
     if(areas_.find(id) != areas_.end())
     {
-        return areas_.at(id).areaName;
+        return Name(name_pool_.name(areas_.at(id).areaName));
     }
     return NO_NAME;
 }
@@ -117,210 +2157,613 @@ std::vector<Coord> Datastructures::get_area_coords(AreaID id)
 {
     if(areas_.find(id) != areas_.end())
     {
-        return areas_.at(id).shape;
+        PackedShape const& shape = areas_.at(id).shape;
+        std::vector<Coord> coords(shape.size());
+        shape.decode(coords.data());
+        return coords;
+    }
+    return {NO_COORD};
+}
+
+std::pair<Coord,Coord> Datastructures::area_bbox(AreaID id)
+{
+    auto area = areas_.find(id);
+    if (area == areas_.end())
+    {
+        return {NO_COORD,NO_COORD};
+    }
+    return {area->second.boxMin,area->second.boxMax};
+}
+
+AreaSize Datastructures::area_size(AreaID id)
+{
+    auto area = areas_.find(id);
+    if (area == areas_.end())
+    {
+        return NO_AREA_SIZE;
+    }
+    return std::abs(area->second.doubledSignedSize)/2.0;
+}
+
+Coord Datastructures::area_centroid(AreaID id)
+{
+    auto area = areas_.find(id);
+    if (area == areas_.end())
+    {
+        return NO_COORD;
+    }
+    return area->second.centroid;
+}
+
+void Datastructures::creation_finished()
+{
+    build_deferred_indexes_();
+    freeze_way_graph_();
+    freeze_area_forest_();
+    freeze_area_rtree_();
+}
+
+
+std::vector<PlaceID> Datastructures::places_alphabetically()
+{
+    build_deferred_indexes_();
+    // places_in_alphabetical_order_ is kept in order by add_place, change_place_name
+    // and remove_place, so the IDs only have to be read from it in order if
+    // something has changed since the last call.
+    if (!alphabetical_order_cache_valid_)
+    {
+        alphabetical_order_cache_.clear();
+        alphabetical_order_cache_.reserve(places_in_alphabetical_order_.size());
+        // for loop complexity: O(n)
+        for (auto const& place : places_in_alphabetical_order_)
+        {
+            alphabetical_order_cache_.push_back(place.second); // push_back() is constant in time, memory was reserved above.
+        }
+        alphabetical_order_cache_valid_ = true;
+    }
+    return alphabetical_order_cache_;
+}
+
+std::vector<PlaceID> Datastructures::places_coord_order()
+{
+    build_deferred_indexes_();
+    // places_in_coord_order_ is ordered by the squared distance from origo
+    // (and y-coordinate if distances are the same), so the IDs are just read
+    // from it in order if places have changed since the last call.
+    if (!coord_order_cache_valid_)
+    {
+        coord_order_cache_.clear();
+        coord_order_cache_.reserve(places_in_coord_order_.size());
+        // for loop complexity: O(n)
+        for (auto const& place : places_in_coord_order_)
+        {
+            coord_order_cache_.push_back(std::get<2>(place));
+        }
+        coord_order_cache_valid_ = true;
+    }
+    return coord_order_cache_;
+}
+
+
+std::vector<PlaceID> Datastructures::find_places_name(Name const& name)
+{
+    build_deferred_indexes_();
+    NameHandle handle = name_pool_.find(name); // average constant, worst-case O(n).
+    if (handle == NO_NAME_HANDLE || handle >= places_by_name_.size())
+    {
+        return {}; // (a name of only areas may have no list of places)
+    }
+
+    // Only the places that really have this name are looped through.
+    auto const& ids = places_by_name_[handle];
+    return std::vector<PlaceID>(ids.begin(),ids.end());
+}
+
+std::vector<PlaceID> Datastructures::find_places_name_prefix(Name const& prefix, int limit)
+{
+    build_deferred_indexes_();
+    std::vector<PlaceID> result;
+    if (limit <= 0)
+    {
+        return result;
+    }
+
+    // All names starting with the prefix are right after the first name that is not
+    // smaller than the prefix, so no other part of the set has to be looked at.
+    auto place = places_in_alphabetical_order_.lower_bound(std::string_view(prefix)); // O(log n)
+    while (place != places_in_alphabetical_order_.end() && result.size() < static_cast<std::size_t>(limit))
+    {
+        if (name_pool_.name(place->first).compare(0,prefix.size(),prefix) != 0)
+        {
+            break;
+        }
+        result.push_back(place->second);
+        ++place;
+    }
+    return result;
+}
+
+std::vector<PlaceID> Datastructures::find_places_fuzzy(Name const& query, int max_results)
+{
+    build_deferred_indexes_();
+    if (max_results <= 0)
+    {
+        return {};
+    }
+
+    std::size_t max_edits = std::max<std::size_t>(1,query.size()/4);
+    std::size_t query_trigrams = TrigramIndex::trigrams(query).size();
+    std::size_t min_shared = query_trigrams > 3*max_edits ? query_trigrams-3*max_edits : 1;
+
+    // (edit distance, name, handle) of the names that are close enough
+    std::vector<std::tuple<std::size_t,std::string_view,NameHandle>> closest;
+    for (NameHandle handle : name_pool_.trigrams().candidates(query,min_shared))
+    {
+        std::string_view name = name_pool_.name(handle);
+        std::size_t distance = edit_distance(query,name,max_edits);
+        if (distance <= max_edits && handle < places_by_name_.size() && !places_by_name_[handle].empty())
+        {
+            closest.emplace_back(distance,name,handle); // (a name of only areas has no places)
+        }
+    }
+    std::sort(closest.begin(),closest.end());
+
+    std::vector<PlaceID> result;
+    std::size_t limit = static_cast<std::size_t>(max_results);
+    for (auto const& name : closest)
+    {
+        if (result.size() >= limit)
+        {
+            break;
+        }
+        auto const& ids = places_by_name_[std::get<2>(name)];
+        std::size_t first = result.size();
+        result.insert(result.end(),ids.begin(),ids.end());
+        std::sort(result.begin()+first,result.end());
+    }
+    if (result.size() > limit)
+    {
+        result.resize(limit);
+    }
+    return result;
+}
+
+std::vector<PlaceID> Datastructures::find_places_type(PlaceType type)
+{
+    build_deferred_indexes_();
+    if (type == PlaceType::NO_TYPE)
+    {
+        return {};
+    }
+    // The bucket already contains exactly the right places, so it is just copied.
+    return places_by_type_[static_cast<std::size_t>(type)];
+}
+
+bool Datastructures::change_place_name(PlaceID id, const Name& newname)
+{
+    build_deferred_indexes_();
+    std::size_t slot = places_.find(id);
+    if (slot != PlaceStore::NO_SLOT)
+    {
+        NameHandle& handle = places_.names[slot];
+        // The entry is erased before the handle is released, as the set needs the name to find it.
+        places_in_alphabetical_order_.erase({handle,id}); // O(log n)
+        unindex_place_name_(id,handle);
+        handle = name_pool_.intern(newname);
+        index_place_name_(id,handle);
+        places_in_alphabetical_order_.insert({handle,id}); // O(log n)
+        alphabetical_order_cache_valid_ = false;
+        return true;
+    }
+    return false;
+}
+
+bool Datastructures::change_place_coord(PlaceID id, Coord newcoord)
+{
+    build_deferred_indexes_();
+    std::size_t slot = places_.find(id);
+    if (slot != PlaceStore::NO_SLOT)
+    {
+        Coord oldcoord = places_.coord(slot);
+        places_in_coord_order_.erase(coord_order_key_(id,oldcoord)); // O(log n)
+        place_grids_[static_cast<std::size_t>(places_.types[slot])].move(id,oldcoord,newcoord);
+        place_grids_[static_cast<std::size_t>(PlaceType::NO_TYPE)].move(id,oldcoord,newcoord);
+        places_.set_coord(slot,newcoord);
+        places_in_coord_order_.insert(coord_order_key_(id,newcoord)); // O(log n)
+        coord_order_cache_valid_ = false;
+        return true;
+    }
+    return false;
+}
+
+std::vector<AreaID> Datastructures::all_areas()
+{
+    std::vector<AreaID> areaIDs;
+    areaIDs.reserve(areas_.size());
+    for (auto const& area : areas_) // no copies of the areas
+    {
+        areaIDs.push_back(area.first);
+    }
+    return areaIDs;
+}
+
+bool Datastructures::add_subarea_to_area(AreaID id, AreaID parentid)
+{
+    if(areas_.find(id) != areas_.end() and
+       areas_.find(parentid) != areas_.end())             // find() for HashMap is constant averagely, worst-case O(n);
+    {
+        if(!areas_.at(id).isSubArea)
+        {
+            areas_.at(parentid).childrenAreas.push_back(id); // .push_back() to vector is constant.
+            areas_.at(id).isSubArea = true;               // .at() for HashMap is similar in complexity.
+            areas_.at(id).parentAreaID = parentid;
+            if (area_forest_valid_ && area_forest_usable_)
+            {
+                std::uint32_t index = area_forest_.find(id);
+                std::uint32_t parent_index = area_forest_.find(parentid);
+                // id has no parent yet, so the link closes a cycle if parentid is under it.
+                if (area_forest_.root_of(parent_index) == index)
+                {
+                    area_forest_usable_ = false;
+                }
+                else
+                {
+                    area_forest_.link(index,parent_index);
+                }
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<AreaID> Datastructures::subarea_in_areas(AreaID id)
+{
+    if(areas_.find(id)==areas_.end()) // .find() and .end() for unordered_map is constant on average, worst-case O(n).
+    {
+        return {NO_AREA};
+    }
+    std::vector<AreaID> upper_areas;
+    get_upper_areas_(id,upper_areas); // O(n)
+    return upper_areas;
+}
+
+bool Datastructures::is_subarea_of(AreaID id, AreaID parentid)
+{
+    freeze_area_forest_();
+    if (!area_forest_usable_)
+    {
+        std::vector<AreaID> upper_areas;
+        get_upper_areas_(id,upper_areas);
+        return std::find(upper_areas.begin(),upper_areas.end(),parentid) != upper_areas.end();
+    }
+    std::uint32_t index = area_forest_.find(id);
+    std::uint32_t parent_index = area_forest_.find(parentid);
+    if (index == AreaForest::NO_INDEX || parent_index == AreaForest::NO_INDEX)
+    {
+        return false;
     }
-    return {NO_COORD};
+    return area_forest_.contains(parent_index,index);
 }
 
-void Datastructures::creation_finished()
+std::vector<AreaID> Datastructures::areas_containing(Coord xy)
 {
-    // Replace this comment with your implementation
-    // NOTE!! It's quite ok to leave this empty, if you don't need operations
-    // that are performed after all additions have been done.
+    freeze_area_rtree_();
+    // Nested areas are smaller than the areas around them, so the innermost is the smallest.
+    std::vector<std::pair<long long,AreaID>> containing; // (twice the size of the shape, ID)
+    area_rtree_.find(xy,containing);
+    std::sort(containing.begin(),containing.end());
+    std::vector<AreaID> result;
+    result.reserve(containing.size());
+    for (auto const& area : containing)
+    {
+        result.push_back(area.second);
+    }
+    return result;
 }
 
-
-std::vector<PlaceID> Datastructures::places_alphabetically()
+std::vector<PlaceID> Datastructures::places_in_area(AreaID id, bool recursive)
 {
-    std::map<Name,PlaceID> placesInAlphabeticalOrder;
-
-   // for-loop complexity: O(n)
-    for (auto place : places_)
+    auto area = areas_.find(id);
+    if (area == areas_.end())
     {
-        placesInAlphabeticalOrder.insert({place.second.placeName,place.first}); // .insert() for map complexity: O(log n)
+        return {NO_PLACE};
     }
-
-    // now places are in alphabetical order since map sorts them.
-    std::vector<PlaceID> placeIDsInOrder;
-
-    // for loop complexity: O(n)
-    for (auto place : placesInAlphabeticalOrder)
+    build_deferred_indexes_();
+    PlaceGrid& grid = place_grids_[static_cast<std::size_t>(PlaceType::NO_TYPE)];
+    // Every place in the bounding box is tested against the shape, so it is decoded once.
+    std::vector<Coord> shape(area->second.shape.size());
+    area->second.shape.decode(shape.data());
+    std::vector<PlaceID> places = grid.in_polygon(shape.data(),shape.size(),area->second.boxMin,area->second.boxMax);
+    if (!recursive)
     {
-        placeIDsInOrder.push_back(place.second); // push_back() is constant in time. O(1).
+        return places;
     }
 
-    return placeIDsInOrder;
+    std::vector<AreaID> subareas;
+    get_subareas_(id,subareas);
+    if (subareas.empty())
+    {
+        return places;
+    }
+    for (AreaID subarea : subareas)
+    {
+        Area const& subarea_data = areas_.at(subarea);
+        shape.resize(subarea_data.shape.size());
+        subarea_data.shape.decode(shape.data());
+        std::vector<PlaceID> subarea_places = grid.in_polygon(shape.data(),shape.size(),subarea_data.boxMin,subarea_data.boxMax);
+        places.insert(places.end(),subarea_places.begin(),subarea_places.end());
+    }
+    // A place may be inside many of the areas.
+    std::sort(places.begin(),places.end());
+    places.erase(std::unique(places.begin(),places.end()),places.end());
+    return places;
 }
 
-std::vector<PlaceID> Datastructures::places_coord_order()
+std::size_t Datastructures::build_area_hierarchy()
 {
-    // Let's use multimap to sort places based on their location.
-    // lets use strucutre map<double,map<int,PlaceID>>
-    // because there might be places with same distance from origo
-    // but with different y-coordinates. double is distance from origo,
-    // int is y-coordinate.
-
-    std::map<double,std::multimap<int,PlaceID>> places_in_order;
-    get_places_in_order({0,0},PlaceType::NO_TYPE,places_in_order);
+    freeze_area_rtree_();
+    std::vector<AreaID> orphans; // areas that are not subareas yet
+    for (auto const& area : areas_)
+    {
+        if (!area.second.isSubArea && !area.second.shape.empty())
+        {
+            orphans.push_back(area.first);
+        }
+    }
 
-    std::vector<PlaceID> place_IDs_in_order;
-    // For-loop above: O(n).
-    for (auto place : places_in_order)
+    // The threads take the areas in small batches, since the shapes differ a lot in size.
+    // Each result is written only by the thread that took the area.
+    constexpr std::size_t BATCH_SIZE = 64;
+    std::vector<AreaID> parents(orphans.size(),NO_AREA);
+    std::atomic<std::size_t> next_batch(0);
+    auto find_parents = [&]()
     {
-        if (place.second.size()==1)
+        std::vector<std::pair<long long,AreaID>> candidates;
+        std::vector<Coord> inner;
+        std::vector<Coord> outer;
+        for (std::size_t begin = next_batch.fetch_add(BATCH_SIZE); begin < orphans.size();
+             begin = next_batch.fetch_add(BATCH_SIZE))
         {
-            place_IDs_in_order.push_back(place.second.begin()->second);
+            std::size_t end = std::min(begin+BATCH_SIZE,orphans.size());
+            for (std::size_t i = begin; i < end; ++i)
+            {
+                parents[i] = smallest_enclosing_area_(orphans[i],candidates,inner,outer);
+            }
         }
-        else
+    };
+    std::size_t thread_count = std::min<std::size_t>(std::max(1u,std::thread::hardware_concurrency()),
+                                                     (orphans.size()+BATCH_SIZE-1)/BATCH_SIZE);
+    std::vector<std::thread> threads;
+    for (std::size_t i = 1; i < thread_count; ++i)
+    {
+        try
         {
-            for(auto place_with_same_distance : place.second)                   // Allthough there is a for-loop inside of for-loop
-            {                                                                   // the complexity of this structure is not O(n^2).
-                place_IDs_in_order.push_back(place_with_same_distance.second);  // Due to the datastructure map<double,multimap<int,PlaceID>> we are using,
-            }                                                                   // if we enter to that internal for-loop, it means that there are less
-        }                                                                       // places to loop through in the outermost for-loop. (Because if we enter to
-     }                                                                          // to the second for-loop, there are at least two places with the exact same
-    return place_IDs_in_order;                                                  // distance from origo, but we don't enter to that second for loop every time)                                                                                // so therefore the efficiency of this structure is theta(n), since .push_back() is constant                                                                                // in time for vector.
-}                                                                               // This for-for-structure loops through every place there is,
-                                                                                // causing it to be linear in complexity. (The exact efficiency would be something
-                                                                                // like O(n + m) in which the m is amount of distances that multiple places have.
-                                                                                // (Due to the if-else). But we can approximate and say that asymptotic efficiency is O(n).
-
-
-std::vector<PlaceID> Datastructures::find_places_name(Name const& name)
-{
-    std::vector<PlaceID> places_with_name;
+            threads.emplace_back(find_parents);
+        }
+        catch (std::system_error const&)
+        {
+            break; // the threads already started share the work
+        }
+    }
+    find_parents();
+    for (std::thread & thread : threads)
+    {
+        thread.join();
+    }
 
-    // for-loop makes this operation linear.
-    for(auto place : places_)
+    std::size_t added = 0;
+    for (std::size_t i = 0; i < orphans.size(); ++i)
     {
-        if(place.second.placeName == name)
+        AreaID id = orphans[i];
+        AreaID parentid = parents[i];
+        if (parentid == NO_AREA)
+        {
+            continue;
+        }
+        // The areas found are nested by size, but an existing subarea of id may still
+        // contain it. The walk is capped in case the existing subareas already make a cycle.
+        AreaID upper = parentid;
+        for (std::size_t steps = 0; upper != NO_AREA && upper != id && steps < areas_.size(); ++steps)
         {
-            places_with_name.push_back(place.first); //push_back() complexity: constant.
+            Area const& upper_area = areas_.at(upper);
+            upper = upper_area.isSubArea ? upper_area.parentAreaID : NO_AREA;
+        }
+        if (upper != id && add_subarea_to_area(id,parentid))
+        {
+            ++added;
         }
     }
-    return places_with_name;
+    return added;
 }
 
-std::vector<PlaceID> Datastructures::find_places_type(PlaceType type)
+std::vector<PlaceID> Datastructures::places_closest_to(Coord xy, PlaceType type)
 {
-    std::vector<PlaceID> places_with_right_type;
+    build_deferred_indexes_();
+    // The grid at index NO_TYPE contains all places, so no special case is needed.
+    return place_grids_[static_cast<std::size_t>(type)].nearest(xy,3);
+}
 
-    // for-loop makes this operation linear.
-    for(auto place : places_)
+std::vector<PlaceID> Datastructures::places_nearest(Coord xy, PlaceType type, int k)
+{
+    build_deferred_indexes_();
+    if (k <= 0)
     {
-        if(place.second.type == type)
-        {
-            places_with_right_type.push_back(place.first); //push_back() complexity: constant.
-        }
+        return {};
     }
-    return places_with_right_type;
+    return place_grids_[static_cast<std::size_t>(type)].nearest(xy,static_cast<std::size_t>(k));
 }
 
-bool Datastructures::change_place_name(PlaceID id, const Name& newname)
+std::vector<PlaceID> Datastructures::places_within_radius(Coord xy, Distance radius, PlaceType type)
+{
+    build_deferred_indexes_();
+    return place_grids_[static_cast<std::size_t>(type)].within_radius(xy,radius);
+}
+
+std::vector<PlaceID> Datastructures::places_in_rect(Coord min, Coord max, PlaceType type)
+{
+    build_deferred_indexes_();
+    return place_grids_[static_cast<std::size_t>(type)].in_rect(min,max);
+}
+
+Span<PlaceID const> Datastructures::place_ids() const
+{
+    return {places_.ids.data(),places_.ids.size()};
+}
+
+PlaceView Datastructures::place_view(PlaceID id) const
 {
-    if (places_.find(id) != places_.end())
+    std::size_t slot = places_.find(id);
+    if (slot == PlaceStore::NO_SLOT)
     {
-        places_.at(id).placeName = newname;
-        return true;
+        return {NO_PLACE,NO_NAME,PlaceType::NO_TYPE,NO_COORD};
     }
-    return false;
+    return {id,name_pool_.name(places_.names[slot]),places_.types[slot],places_.coord(slot)};
 }
 
-bool Datastructures::change_place_coord(PlaceID id, Coord newcoord)
+AreaView Datastructures::area_view(AreaID id) const
 {
-    if (places_.find(id) != places_.end())
+    auto area = areas_.find(id);
+    if (area == areas_.end())
     {
-        places_.at(id).location = newcoord;
-        return true;
+        return {NO_AREA,NO_NAME,{}};
     }
-    return false;
+    return {id,name_pool_.name(area->second.areaName),area->second.shape};
 }
 
-std::vector<AreaID> Datastructures::all_areas()
+WayView Datastructures::way_view(WayID id) const
 {
-    std::vector<AreaID> areaIDs;
-    for (auto area : areas_)
+    auto way = ways_.find(id);
+    if (way == ways_.end())
     {
-        areaIDs.push_back(area.first);
+        return {NO_WAY,{},NO_DISTANCE};
     }
-    return areaIDs;
+    return {way->first,way->second.coordinates,way->second.distance}; // the ID stored in ways_, not the parameter
 }
 
-bool Datastructures::add_subarea_to_area(AreaID id, AreaID parentid)
+bool Datastructures::remove_place(PlaceID id)
 {
-    if(areas_.find(id) != areas_.end() and
-       areas_.find(parentid) != areas_.end())             // find() for unordered_map is constant averagely, worst-case O(n);
+    build_deferred_indexes_();
+    std::size_t slot = places_.find(id);
+    if (slot == PlaceStore::NO_SLOT)
     {
-        if(!areas_.at(id).isSubArea)
-        {
-            areas_.at(parentid).childrenAreas.push_back(id); // .push_back() to vector is constant.
-            areas_.at(id).isSubArea = true;               // .at() for unordered_map is similar in complexity.
-            areas_.at(id).parentAreaID = parentid;
-            return true;
-        }
+        return false;
     }
-    return false;
+    NameHandle handle = places_.names[slot];
+    Coord xy = places_.coord(slot);
+    places_in_alphabetical_order_.erase({handle,id}); // O(log n)
+    unindex_place_name_(id,handle);
+    remove_from_type_bucket_(slot); // constant on average.
+    alphabetical_order_cache_valid_ = false;
+    places_in_coord_order_.erase(coord_order_key_(id,xy)); // O(log n)
+    coord_order_cache_valid_ = false;
+    place_grids_[static_cast<std::size_t>(places_.types[slot])].erase(id,xy);
+    place_grids_[static_cast<std::size_t>(PlaceType::NO_TYPE)].erase(id,xy);
+    places_.remove(slot); // swap-remove, constant on average.
+    return true;
 }
 
-std::vector<AreaID> Datastructures::subarea_in_areas(AreaID id)
+std::tuple<long long, int, PlaceID> Datastructures::coord_order_key_(PlaceID id, Coord xy)
 {
-    if(areas_.find(id)==areas_.end()) // .find() and .end() for unordered_map is constant on average, worst-case O(n).
+    // Squared distance keeps the same order as the real distance, and
+    // it can be calculated exactly with integers.
+    return std::make_tuple(squared_distance(xy,{0,0}),xy.y,id);
+}
+
+void Datastructures::add_to_type_bucket_(std::size_t slot)
+{
+    auto& bucket = places_by_type_[static_cast<std::size_t>(places_.types[slot])];
+    places_.type_bucket_indexes[slot] = bucket.size();
+    bucket.push_back(places_.ids[slot]); // amortized constant.
+}
+
+void Datastructures::remove_from_type_bucket_(std::size_t slot)
+{
+    // The last ID of the bucket is moved to the place of the removed one,
+    // so no other elements need to be shifted (swap-remove).
+    auto& bucket = places_by_type_[static_cast<std::size_t>(places_.types[slot])];
+    std::size_t index = places_.type_bucket_indexes[slot];
+    PlaceID moved_id = bucket.back();
+    bucket[index] = moved_id;
+    places_.type_bucket_indexes[places_.find(moved_id)] = index; // constant on average.
+    bucket.pop_back();
+}
+
+void Datastructures::index_place_name_(PlaceID id, NameHandle name)
+{
+    if (places_by_name_.size() < name_pool_.handle_count())
     {
-        return {NO_AREA};
+        places_by_name_.resize(name_pool_.handle_count()); // amortized constant.
     }
-    std::vector<AreaID> upper_areas;
-    get_upper_areas_(id,upper_areas); // O(n)
-    return upper_areas;
+    places_by_name_[name].insert(id);
 }
 
-std::vector<PlaceID> Datastructures::places_closest_to(Coord xy, PlaceType type)
+void Datastructures::build_deferred_indexes_()
 {
-    std::map<double,std::multimap<int,PlaceID>> closest_places;
-    get_places_in_order(xy,type,closest_places); // O(n*log(n))
-    std::vector<PlaceID> three_closest_places;
+    if (!indexes_deferred_)
+    {
+        return;
+    }
+    indexes_deferred_ = false;
 
-    // Allthough there is for-loop inside a for-loop, the
-    // complexity of this structure is not O(n^2).
-    // (Read detailed explanation why it is not from
-    // places_coord_order where this kind of structure
-    // were used as well.)
-    // That is because we stop looping by using break
-    // after three places are added to vector.
-    // On this function's case, the above for-structure
-    // is actually consant, since the looping will
-    // be stopped after 3 places are added to vector and
-    // the places are already in right order in closest_places.
-    for (auto place : closest_places)
+    name_pool_.index_deferred_trigrams();
+
+    if (deferred_places_ > 0)
     {
-        if(place.second.size()==1)
+        std::size_t first = places_.size()-deferred_places_;
+        deferred_places_ = 0;
+
+        std::vector<std::pair<NameHandle,PlaceID>> by_name;
+        std::vector<std::tuple<long long,int,PlaceID>> by_coord;
+        std::array<std::vector<PlaceID>,static_cast<std::size_t>(PlaceType::NO_TYPE)+1> grid_ids;
+        std::array<std::vector<Coord>,static_cast<std::size_t>(PlaceType::NO_TYPE)+1> grid_coords;
+        by_name.reserve(places_.size()-first);
+        by_coord.reserve(places_.size()-first);
+        for (std::size_t slot = first; slot < places_.size(); ++slot)
         {
-            three_closest_places.push_back(place.second.begin()->second);
-            if(three_closest_places.size()==3)
+            PlaceID id = places_.ids[slot];
+            Coord xy = places_.coord(slot);
+            index_place_name_(id,places_.names[slot]);
+            add_to_type_bucket_(slot);
+            by_name.push_back({places_.names[slot],id});
+            by_coord.push_back(coord_order_key_(id,xy));
+            for (std::size_t grid : {static_cast<std::size_t>(places_.types[slot]),static_cast<std::size_t>(PlaceType::NO_TYPE)})
             {
-                break;
+                grid_ids[grid].push_back(id);
+                grid_coords[grid].push_back(xy);
             }
         }
-        else
+
+        // Sorted ranges are inserted with the end of the set as the hint, which is
+        // amortized constant per place when the set was empty.
+        std::sort(by_name.begin(),by_name.end(),places_in_alphabetical_order_.key_comp());
+        places_in_alphabetical_order_.insert(by_name.begin(),by_name.end());
+        alphabetical_order_cache_valid_ = false;
+        std::sort(by_coord.begin(),by_coord.end());
+        places_in_coord_order_.insert(by_coord.begin(),by_coord.end());
+        coord_order_cache_valid_ = false;
+
+        for (std::size_t grid = 0; grid < place_grids_.size(); ++grid)
         {
-            for(auto place_with_nonunique_distance : place.second)
+            if (!grid_ids[grid].empty())
             {
-                three_closest_places.push_back(place_with_nonunique_distance.second);
-                if(three_closest_places.size()==3)
-                {
-                    break;
-                }
+                place_grids_[grid].insert_all(grid_ids[grid],grid_coords[grid]);
             }
         }
     }
 
-    return three_closest_places;;
+    for (WayID const& id : deferred_ways_)
+    {
+        Span<Coord const> coordinates = ways_.at(id).coordinates;
+        connect_way_(id,coordinates.front(),coordinates.back());
+    }
+    deferred_ways_.clear();
 }
 
-bool Datastructures::remove_place(PlaceID id)
+void Datastructures::unindex_place_name_(PlaceID id, NameHandle name)
 {
-    auto result = places_.erase(id);
-    return result; // if erase was successful, result == 1,
-                   // otherwise (id not found), result == 0.
+    places_by_name_[name].erase(id);
+    name_pool_.release(name); // a handle that no place or area uses anymore is reused for a new name.
 }
 
 std::vector<AreaID> Datastructures::all_subareas_in_area(AreaID id)
@@ -336,13 +2779,38 @@ std::vector<AreaID> Datastructures::all_subareas_in_area(AreaID id)
 
 void Datastructures::get_subareas_(AreaID id,std::vector<AreaID> & subareas_already_added)
 {
-    if(areas_.find(id) != areas_.end())
+    freeze_area_forest_();
+    if (area_forest_usable_)
+    {
+        std::uint32_t index = area_forest_.find(id);
+        if (index != AreaForest::NO_INDEX)
+        {
+            area_forest_.subareas(index,subareas_already_added);
+        }
+        return;
+    }
+    // Preorder walk with an explicit stack of (children, position of the next child), so
+    // deep hierarchies do not overflow the call stack. The subareas form a cycle here, so
+    // the walk stops when more subareas than areas have been added.
+    auto area = areas_.find(id);
+    if (area == areas_.end())
+    {
+        return;
+    }
+    std::size_t limit = subareas_already_added.size()+areas_.size();
+    std::vector<std::pair<std::vector<AreaID> const*,std::size_t>> stack;
+    stack.push_back({&area->second.childrenAreas,0});
+    while (!stack.empty() && subareas_already_added.size() < limit)
     {
-        for(auto subarea : areas_.at(id).childrenAreas)
+        auto& [children, next_child] = stack.back();
+        if (next_child == children->size())
         {
-            subareas_already_added.push_back(subarea);
-            get_subareas_(subarea,subareas_already_added);
+            stack.pop_back();
+            continue;
         }
+        AreaID subarea = (*children)[next_child++];
+        subareas_already_added.push_back(subarea);
+        stack.push_back({&areas_.at(subarea).childrenAreas,0}); // invalidates children
     }
 }
 
@@ -354,12 +2822,27 @@ AreaID Datastructures::common_area_of_subareas(AreaID id1, AreaID id2)
         return NO_AREA;
     }
 
+    freeze_area_forest_();
+    if (area_forest_usable_)
+    {
+        // Upper areas of an area do not include the area itself, so the nearest common
+        // area is the common ancestor of the parents.
+        std::uint32_t parent1 = area_forest_.parent(area_forest_.find(id1));
+        std::uint32_t parent2 = area_forest_.parent(area_forest_.find(id2));
+        if (parent1 == AreaForest::NO_INDEX || parent2 == AreaForest::NO_INDEX)
+        {
+            return NO_AREA;
+        }
+        std::uint32_t common = area_forest_.common_ancestor(parent1,parent2); // O(log n) amortized
+        return common == AreaForest::NO_INDEX ? NO_AREA : area_forest_.id(common);
+    }
+
     std::vector<AreaID> upper_areas_1;
     std::vector<AreaID> upper_areas_2;
 
     // Let's fullfill vector above with upper areas of
     // areas representing IDs id1 and id2. Fullfillment
-    // is done by using recursive function get_upper_areas.
+    // is done by using function get_upper_areas_.
     // by using vector we ensure that areas are in right
     // order. ("father" -- "grandfather" -- etc.)
 
@@ -391,77 +2874,293 @@ AreaID Datastructures::common_area_of_subareas(AreaID id1, AreaID id2)
     return nearest_common_area;
 }
 
-void Datastructures::get_upper_areas_(AreaID id, std::vector<AreaID> & upper_areas)
+bool Datastructures::remove_area(AreaID id)
 {
-    if(areas_.find(id) != areas_.end())
+    build_deferred_indexes_(); // the handle of the name may be reused after release()
+    auto area = areas_.find(id);
+    if (area == areas_.end())
+    {
+        return false;
+    }
+    freeze_area_forest_();
+    AreaID parentid = area->second.parentAreaID;
+    if (parentid == id)
+    {
+        parentid = NO_AREA; // the area is its own parent, so the subareas have no parent to move to
+    }
+    std::vector<AreaID> children = std::move(area->second.childrenAreas);
+    if (parentid != NO_AREA)
+    {
+        std::vector<AreaID>& siblings = areas_.at(parentid).childrenAreas;
+        siblings.erase(std::find(siblings.begin(),siblings.end(),id));
+    }
+    bool update_forest = area_forest_valid_ && area_forest_usable_;
+    for (AreaID child : children)
     {
-        if(areas_.at(id).parentAreaID != NO_AREA)
+        if (child == id)
+        {
+            continue;
+        }
+        // In a cycle of subareas the parent may also be a subarea, and it cannot contain itself.
+        AreaID new_parent = child == parentid ? NO_AREA : parentid;
+        Area& child_area = areas_.at(child);
+        child_area.parentAreaID = new_parent;
+        child_area.isSubArea = new_parent != NO_AREA;
+        if (new_parent != NO_AREA)
+        {
+            areas_.at(new_parent).childrenAreas.push_back(child);
+        }
+        if (update_forest)
         {
-            upper_areas.push_back(areas_.at(id).parentAreaID);
-            get_upper_areas_(areas_.at(id).parentAreaID,upper_areas);
+            std::uint32_t child_index = area_forest_.find(child);
+            area_forest_.cut(child_index);
+            if (new_parent != NO_AREA)
+            {
+                area_forest_.link(child_index,area_forest_.find(new_parent));
+            }
         }
     }
+    if (update_forest)
+    {
+        area_forest_.remove(area_forest_.find(id));
+    }
+    else
+    {
+        area_forest_valid_ = false; // removing an area may break a cycle of subareas
+    }
+
+    name_pool_.release(area->second.areaName);
+    areas_.erase(id); // invalidates area
+    area_rtree_valid_ = false;
+    return true;
 }
 
-void Datastructures::get_places_in_order(Coord xy, PlaceType type, std::map<double,std::multimap<int, PlaceID>> & places_in_order)
+bool Datastructures::move_subarea(AreaID id, AreaID parentid)
 {
-    if(type == PlaceType::NO_TYPE)
+    auto area = areas_.find(id);
+    if (area == areas_.end() || parentid == id || (parentid != NO_AREA && areas_.find(parentid) == areas_.end()))
     {
-        for (auto place : places_)
+        return false;
+    }
+    AreaID old_parentid = area->second.parentAreaID;
+    if (old_parentid == parentid)
+    {
+        return true;
+    }
+    // The area cannot be moved inside itself.
+    if (parentid != NO_AREA && is_subarea_of(parentid,id)) // freezes area_forest_
+    {
+        return false;
+    }
+
+    if (old_parentid != NO_AREA)
+    {
+        std::vector<AreaID>& siblings = areas_.at(old_parentid).childrenAreas;
+        siblings.erase(std::find(siblings.begin(),siblings.end(),id));
+    }
+    if (parentid != NO_AREA)
+    {
+        areas_.at(parentid).childrenAreas.push_back(id);
+    }
+    area->second.parentAreaID = parentid;
+    area->second.isSubArea = parentid != NO_AREA;
+    if (area_forest_valid_ && area_forest_usable_)
+    {
+        std::uint32_t index = area_forest_.find(id);
+        area_forest_.cut(index);
+        if (parentid != NO_AREA)
         {
-            double distance = sqrt(pow(place.second.location.x-xy.x,2)+pow(place.second.location.y-xy.y,2));
+            area_forest_.link(index,area_forest_.find(parentid));
+        }
+    }
+    else
+    {
+        area_forest_valid_ = false; // moving an area may break a cycle of subareas
+    }
+    return true;
+}
 
-            if (places_in_order.find(distance) != places_in_order.end())        // map.find() complexity O(log n)
-            {
-                places_in_order.at(distance).insert(std::make_pair(place.second.location.y,place.first)); // .insert() for map is O(log n) as well.
-            }
-            else
-            {
-                places_in_order[distance] = {std::make_pair(place.second.location.y,place.first)}; // O (log n)
-            }
+void Datastructures::get_upper_areas_(AreaID id, std::vector<AreaID> & upper_areas)
+{
+    freeze_area_forest_();
+    if (area_forest_usable_)
+    {
+        std::uint32_t index = area_forest_.find(id);
+        if (index != AreaForest::NO_INDEX)
+        {
+            area_forest_.upper_areas(index,upper_areas);
         }
         return;
     }
-    for (auto place : places_)
+    // The subareas form a cycle here, so the walk stops when more upper areas than areas
+    // have been added.
+    std::size_t limit = upper_areas.size()+areas_.size();
+    for (auto area = areas_.find(id);
+         area != areas_.end() && area->second.parentAreaID != NO_AREA && upper_areas.size() < limit;
+         area = areas_.find(area->second.parentAreaID))
+    {
+        upper_areas.push_back(area->second.parentAreaID);
+    }
+}
+
+void Datastructures::restore_nodes()
+{
+    // O(n), the arrays are just filled.
+    std::size_t node_count = way_graph_.node_count();
+    node_status_.assign(node_count,WHITE);
+    route_distance_so_far_.assign(node_count,9999999);
+    steps_taken_.assign(node_count,-1);
+    previous_node_.assign(node_count,WayGraph::NO_NODE);
+    previous_edge_.assign(node_count,WayGraph::NO_EDGE);
+}
+
+void Datastructures::freeze_way_graph_()
+{
+    if (!way_graph_valid_)
+    {
+        way_graph_.build(nodes_,ways_);
+        way_graph_valid_ = true;
+    }
+}
+
+void Datastructures::freeze_area_forest_()
+{
+    if (!area_forest_valid_)
+    {
+        // Areas that are subareas of each other are not all linked in the forest.
+        area_forest_usable_ = area_forest_.build(areas_);
+        area_forest_valid_ = true;
+    }
+}
+
+void Datastructures::freeze_area_rtree_()
+{
+    if (!area_rtree_valid_)
+    {
+        area_rtree_.build(areas_);
+        area_rtree_valid_ = true;
+    }
+}
+
+void Datastructures::measure_shape_(std::vector<Coord> const& coords, Area & area)
+{
+    if (coords.empty())
     {
-        double distance = sqrt(pow(place.second.location.x-xy.x,2)+pow(place.second.location.y-xy.y,2));
+        area.boxMin = NO_COORD;
+        area.boxMax = NO_COORD;
+        area.doubledSignedSize = 0;
+        area.centroid = NO_COORD;
+        return;
+    }
 
-        if (places_in_order.find(distance) != places_in_order.end() and place.second.type == type)        // map.find() complexity O(log n)
+    constexpr std::size_t BLOCK_SIZE = 64;
+    long long terms[BLOCK_SIZE];
+    std::size_t count = coords.size();
+    Coord min = coords[0];
+    Coord max = coords[0];
+    long long doubled_size = 0;
+    // The centroid sums do not fit in 64 bits for large shapes, so they are doubles.
+    double sum_x = 0;
+    double sum_y = 0;
+    auto add_edge = [&](Coord a, Coord b, long long term)
+    {
+        doubled_size += term;
+        sum_x += static_cast<double>(static_cast<long long>(a.x)+b.x)*term;
+        sum_y += static_cast<double>(static_cast<long long>(a.y)+b.y)*term;
+    };
+    // Blocks overlap by one coordinate, so that every edge but the closing one gets its term.
+    for (std::size_t start = 0; start+1 < count; start += BLOCK_SIZE)
+    {
+        std::size_t edges = std::min(BLOCK_SIZE,count-1-start);
+        cross_products(coords.data()+start,edges+1,terms);
+        for (std::size_t i = 0; i < edges; ++i)
         {
-            places_in_order.at(distance).insert(std::make_pair(place.second.location.y,place.first)); // .insert() for map is O(log n) as well.
+            add_edge(coords[start+i],coords[start+i+1],terms[i]);
         }
-        else if(place.second.type == type)
+    }
+    for (Coord xy : coords)
+    {
+        min = {std::min(min.x,xy.x),std::min(min.y,xy.y)};
+        max = {std::max(max.x,xy.x),std::max(max.y,xy.y)};
+    }
+    Coord last = coords[count-1];
+    add_edge(last,coords[0],static_cast<long long>(last.x)*coords[0].y - static_cast<long long>(coords[0].x)*last.y);
+
+    area.boxMin = min;
+    area.boxMax = max;
+    area.doubledSignedSize = doubled_size;
+    double centroid_x;
+    double centroid_y;
+    if (doubled_size != 0)
+    {
+        centroid_x = sum_x/(3.0*doubled_size);
+        centroid_y = sum_y/(3.0*doubled_size);
+    }
+    else
+    {
+        // A degenerate shape has no area, so the average of its coordinates is used.
+        double total_x = 0;
+        double total_y = 0;
+        for (Coord xy : coords)
         {
-            places_in_order[distance] = {std::make_pair(place.second.location.y,place.first)}; // O (log n)
+            total_x += xy.x;
+            total_y += xy.y;
         }
+        centroid_x = total_x/count;
+        centroid_y = total_y/count;
     }
-    return;
+    // The centroid of a self-intersecting shape may be outside of it, but is kept in the bounding box.
+    centroid_x = std::clamp(centroid_x,static_cast<double>(min.x),static_cast<double>(max.x));
+    centroid_y = std::clamp(centroid_y,static_cast<double>(min.y),static_cast<double>(max.y));
+    area.centroid = {static_cast<int>(std::lround(centroid_x)),static_cast<int>(std::lround(centroid_y))};
 }
 
-void Datastructures::restore_nodes()
+AreaID Datastructures::smallest_enclosing_area_(AreaID id, std::vector<std::pair<long long,AreaID>> & candidates,
+                                                std::vector<Coord> & inner, std::vector<Coord> & outer) const
 {
-    // O(n). .at() for unordered_map is constant
-    // inside the for-loop, because it is called
-    // only for keys that exist in nodes_.
-    // this is ensured by for-loop ( node : nodes_)
-    for(auto node : nodes_)
+    Area const& area = areas_.at(id);
+    long long doubled_size = area.doubledSignedSize < 0 ? -area.doubledSignedSize : area.doubledSignedSize;
+    candidates.clear();
+    area_rtree_.find_boxes_containing(area.boxMin,area.boxMax,candidates);
+    // Only a larger area can contain the area, or one of the same size with a smaller ID,
+    // so that equal shapes are nested instead of containing each other.
+    candidates.erase(std::remove_if(candidates.begin(),candidates.end(),
+                                    [doubled_size,id](std::pair<long long,AreaID> const& candidate)
+                                    {
+                                        return candidate.first < doubled_size ||
+                                               (candidate.first == doubled_size && candidate.second >= id);
+                                    }),
+                     candidates.end());
+    if (candidates.empty())
+    {
+        return NO_AREA;
+    }
+    std::sort(candidates.begin(),candidates.end(),
+              [](std::pair<long long,AreaID> const& a, std::pair<long long,AreaID> const& b)
+              {
+                  return a.first != b.first ? a.first < b.first : a.second > b.second;
+              });
+
+    inner.resize(area.shape.size());
+    area.shape.decode(inner.data());
+    for (auto const& candidate : candidates)
     {
-        nodes_.at(node.first).node_status = WHITE;
-        nodes_.at(node.first).route_distance_so_far = 9999999;
-        nodes_.at(node.first).steps_taken = -1;
-        nodes_.at(node.first).route_distance_estimate = -1;
-        nodes_.at(node.first).previous_node = nullptr;
-        nodes_.at(node.first).secondary_previous_node = nullptr;
-        nodes_.at(node.first).previous_way = NO_WAY;
-        nodes_.at(node.first).secondary_previous_way = NO_WAY;
+        PackedShape const& shape = areas_.at(candidate.second).shape;
+        outer.resize(shape.size());
+        shape.decode(outer.data());
+        if (polygon_in_polygon(outer.data(),outer.size(),inner.data(),inner.size()))
+        {
+            return candidate.second;
+        }
     }
+    return NO_AREA;
 }
 
 std::vector<WayID> Datastructures::all_ways()
 {
     std::vector<WayID> ways;
     ways.reserve(ways_.size());     // .size() for unordered_map is consant on complexity
-    for(auto way : ways_)           // .reserve() for vector is now O(n), it depends
+    for(auto const& way : ways_)    // .reserve() for vector is now O(n), it depends
     {                               // on size of ways_.
         ways.push_back(way.first); // push_back() is now constant, we reserved the exact right amount of memory
     }                              // by using reserve() earlier, so reallocation does not happen.
@@ -470,6 +3169,7 @@ std::vector<WayID> Datastructures::all_ways()
 
 bool Datastructures::add_way(WayID id, std::vector<Coord> coords)
 {
+    build_deferred_indexes_();
     if(ways_.find(id) != ways_.end()) // find() averagely constant for unordered_map, linear in worst case. end() is constant)
     {
         return false;
@@ -478,40 +3178,63 @@ bool Datastructures::add_way(WayID id, std::vector<Coord> coords)
     // calculate_distance's complexity is O(n).
     Distance way_distance = calculate_distance(coords);
 
-    Way new_way = {coords,way_distance};
+    Way new_way = {ways_arena_.copy(coords.data(),coords.size()),way_distance};
     ways_.insert(std::make_pair(id,new_way));
 
+    connect_way_(id,coords.front(),coords.back()); // constant on average
+    return true;
+}
+
+std::size_t Datastructures::add_ways_bulk(std::vector<std::pair<WayID, std::vector<Coord>>> const& ways)
+{
+    ways_.reserve(ways_.size()+ways.size());
+    std::size_t added = 0;
+    for (auto const& [id, coords] : ways)
+    {
+        if (ways_.find(id) != ways_.end())
+        {
+            continue;
+        }
+        Way new_way = {ways_arena_.copy(coords.data(),coords.size()),calculate_distance(coords)};
+        ways_.insert(std::make_pair(id,new_way));
+        deferred_ways_.push_back(id); // connected to nodes_ by build_deferred_indexes_
+        ++added;
+    }
+    indexes_deferred_ = true;
+    return added;
+}
+
+void Datastructures::connect_way_(WayID const& id, Coord front, Coord back)
+{
+    way_graph_valid_ = false;
     // let's update nodes
-    // .front() and .back() for vector are constants on complexity
-    // .at(), .insert() and .find() for unordered_map are constants on average, linear on worst cases
-    // .end() for unordered_map is constant on complexity
+    // .at(), .insert() and .find() for HashMap are constants on average, linear on worst cases
+    // .end() for HashMap is constant on complexity
     // std::make_pair is constant
     // so the whole node-update-process above are constant on average case, but
     // in the worst case it's linear.
-    if(nodes_.find(coords.front()) == nodes_.end())
+    if(nodes_.find(front) == nodes_.end())
     {
         std::unordered_multimap<Coord,WayID,CoordHash> accesses;
-        accesses.insert(std::make_pair(coords.back(),id));
-        Node new_node = {coords.front(),accesses,WHITE,-1,9999999,-1,nullptr,nullptr,NO_WAY,NO_WAY};
-        nodes_.insert(std::make_pair(coords.front(),new_node));
+        accesses.insert(std::make_pair(back,id));
+        Node new_node = {front,accesses};
+        nodes_.insert(std::make_pair(front,new_node));
     }
     else
     {
-        nodes_.at(coords.front()).accesses.insert(std::make_pair(coords.back(),id));
+        nodes_.at(front).accesses.insert(std::make_pair(back,id));
     }
-    if(nodes_.find(coords.back()) == nodes_.end())
+    if(nodes_.find(back) == nodes_.end())
     {
         std::unordered_multimap<Coord,WayID,CoordHash> accesses;
-        accesses.insert(std::make_pair(coords.front(),id));
-        Node new_node = {coords.back(),accesses,WHITE,-1,9999999,-1,nullptr,nullptr,NO_WAY,NO_WAY};
-        nodes_.insert(std::make_pair(coords.back(),new_node));
+        accesses.insert(std::make_pair(front,id));
+        Node new_node = {back,accesses};
+        nodes_.insert(std::make_pair(back,new_node));
     }
     else
     {
-        nodes_.at(coords.back()).accesses.insert(std::make_pair(coords.front(),id));
-
+        nodes_.at(back).accesses.insert(std::make_pair(front,id));
     }
-    return true;
 }
 
 Distance Datastructures::calculate_distance(const std::vector<Coord> coords)
@@ -526,24 +3249,34 @@ Distance Datastructures::calculate_distance(const std::vector<Coord> coords)
         ++coord)
     {
         auto next_coord = coord +1;
-        Distance x_dist = next_coord->x-coord->x;
-        Distance y_dist = next_coord->y-coord->y;
-        Distance part_dist = floor(sqrt(pow(x_dist,2)+pow(y_dist,2)));
+        // Lengths of the parts are rounded down, computed exactly with integers.
+        Distance part_dist = static_cast<Distance>(integer_sqrt(squared_distance(*coord,*next_coord)));
         dist += part_dist;
     }
     return dist;
 }
 
+long long Datastructures::squared_distance(Coord point1, Coord point2)
+{
+    long long x_dist = static_cast<long long>(point2.x)-point1.x;
+    long long y_dist = static_cast<long long>(point2.y)-point1.y;
+    return x_dist*x_dist + y_dist*y_dist;
+}
+
 Distance Datastructures::distance_between_nodes(Coord point1, Coord point2)
 {
-    Distance x_dist = point2.x-point1.x;
-    Distance y_dist = point2.y-point2.y;
-    Distance dist = sqrt(pow(x_dist,2)+pow(y_dist,2));
-    return dist;
+    // Every way part is at least as long as its larger coordinate difference, and
+    // the lengths of parts are integers rounded down, so this never exceeds the length
+    // of a route between the points. The rounded straight-line distance could exceed
+    // it for a way of many short parts, which would make A* miss the shortest route.
+    long long x_dist = std::abs(static_cast<long long>(point2.x)-point1.x);
+    long long y_dist = std::abs(static_cast<long long>(point2.y)-point1.y);
+    return static_cast<Distance>(std::max(x_dist,y_dist));
 }
 
 std::vector<std::pair<WayID, Coord>> Datastructures::ways_from(Coord xy)
 {
+    build_deferred_indexes_();
 
     std::vector<std::pair<WayID, Coord>> ways_and_crossroads;
     if(nodes_.find(xy) == nodes_.end()) // for unordered_map, .find() constant on average, linear on worst case, .end() constant
@@ -581,12 +3314,13 @@ std::vector<std::pair<WayID, Coord>> Datastructures::ways_from(Coord xy)
 
 std::vector<Coord> Datastructures::get_way_coords(WayID id)
 {
-    // .at() and .find() for unordered_map are constant on average, linear on worst cases,
-    // .end() is constant for unordered_map
+    // .at() and .find() for HashMap are constant on average, linear on worst cases,
+    // .end() is constant for HashMap
     //
     if(ways_.find(id) != ways_.end())
     {
-        return ways_.at(id).coordinates;
+        Span<Coord const> coordinates = ways_.at(id).coordinates;
+        return std::vector<Coord>(coordinates.begin(),coordinates.end());
     }
     return {NO_COORD};
 }
@@ -594,287 +3328,268 @@ std::vector<Coord> Datastructures::get_way_coords(WayID id)
 void Datastructures::clear_ways()
 {
     ways_.clear();      // .clear()'s complexity
-    nodes_.clear();     // for unordered map ilinear on size
+    nodes_.clear();     // for HashMap is linear on capacity
+    ways_arena_.release(); // coordinates of all ways at once
+    deferred_ways_.clear();
+    way_graph_.clear();
+    way_graph_valid_ = false;
 }
 
 std::vector<std::tuple<Coord, WayID, Distance> > Datastructures::route_any(Coord fromxy, Coord toxy)
 {
-    if(nodes_.find(fromxy) == nodes_.end() or
-            nodes_.find(toxy) == nodes_.end()) // for unordered_map .find() is constant on average, linear on worst case, .end() constant
+    build_deferred_indexes_();
+    freeze_way_graph_();
+    std::uint32_t from = way_graph_.find(fromxy); // O(log n)
+    std::uint32_t to = way_graph_.find(toxy);
+    if(from == WayGraph::NO_NODE or to == WayGraph::NO_NODE)
     {
         return {{NO_COORD, NO_WAY, NO_DISTANCE}}; // one or both of coordinates were not nodes.
     }
 
-    if(nodes_.at(fromxy).accesses.size() < 1 or
-       nodes_.at(toxy).accesses.size() < 1) // for unordered_map .find() .at() constant on average, worst case linear,
+    if(way_graph_.edge_start[from] == way_graph_.edge_start[from+1] or
+       way_graph_.edge_start[to] == way_graph_.edge_start[to+1])
     {
           return {{NO_COORD, NO_WAY, NO_DISTANCE}}; // one or both of nodes were not crossroads.
     }
 
     // O(V+E) = O(N)
-    DFS_route(fromxy,toxy);
-    return track_route(toxy);
+    DFS_route(from,to);
+    return track_route(to);
 }
 
-void Datastructures::DFS_route(Coord & fromxy, Coord & toxy)
+void Datastructures::DFS_route(std::uint32_t from, std::uint32_t to)
 {
     // restore_nodes() complexity O(n).
     restore_nodes();
     // DFS's complexity is O(V+E) in which
     // V is the amount of nodes in a graph, and E
     // the amount of edges in a graph.
-    std::stack<Node*> DFS_stack;
-    Node* starting_point = &nodes_.at(fromxy); // .at() constant on average, linear in worst case.
-    starting_point->route_distance_so_far = 0;
-    starting_point->steps_taken = 0;
-    DFS_stack.push(starting_point);
-    while (DFS_stack.size() > 0)
-    {
-        Node* top_node = DFS_stack.top();
-        DFS_stack.pop();
-        if(top_node->node_status == WHITE)
-        {
-            top_node->node_status = GRAY;
-            DFS_stack.push(top_node);
-            if(top_node->location == toxy)
-            {
-                top_node->node_status = BLACK; // is this necessary?
-                DFS_stack = {};
+    std::vector<std::uint32_t> DFS_stack;
+    route_distance_so_far_[from] = 0;
+    steps_taken_[from] = 0;
+    DFS_stack.push_back(from);
+    while (!DFS_stack.empty())
+    {
+        std::uint32_t top_node = DFS_stack.back();
+        DFS_stack.pop_back();
+        if(node_status_[top_node] == WHITE)
+        {
+            node_status_[top_node] = GRAY;
+            DFS_stack.push_back(top_node);
+            if(top_node == to)
+            {
+                node_status_[top_node] = BLACK; // is this necessary?
                 break;
             }
-            for(auto neighbour : DFS_stack.top()->accesses)
+            for(std::uint32_t edge = way_graph_.edge_start[top_node]; edge < way_graph_.edge_start[top_node+1]; ++edge)
             {
-                if(nodes_.at(neighbour.first).node_status == WHITE)
+                std::uint32_t neighbour = way_graph_.edge_to[edge];
+                if(node_status_[neighbour] == WHITE)
                 {
-                    nodes_.at(neighbour.first).previous_node = top_node;
-                    nodes_.at(neighbour.first).previous_way = neighbour.second;
-                    nodes_.at(neighbour.first).route_distance_so_far = top_node->route_distance_so_far +
-                                                                       ways_.at(neighbour.second).distance;
-                    DFS_stack.push(&nodes_.at(neighbour.first));
+                    previous_node_[neighbour] = top_node;
+                    previous_edge_[neighbour] = edge;
+                    route_distance_so_far_[neighbour] = route_distance_so_far_[top_node] + way_graph_.edge_distance[edge];
+                    DFS_stack.push_back(neighbour);
                 }
             }
         }
         else
         {
-            top_node->node_status = BLACK;
+            node_status_[top_node] = BLACK;
         }
     }
 }
 
-Node* Datastructures::DFS_cycle(Coord &fromxy)
+std::uint32_t Datastructures::DFS_cycle(std::uint32_t from, std::uint32_t & cycle_previous_node, std::uint32_t & cycle_previous_edge)
 {
     // restore_nodes() complexity O(n).
     restore_nodes();
     // DFS's complexity is O(V+E) in which
     // V is the amount of nodes in a graph, and E
     // the amount of edges in a graph.
-    std::stack<Node*> DFS_stack;
-    Node* starting_point = &nodes_.at(fromxy); // .at() constant on average, linear in worst case.
-    starting_point->steps_taken = 0;
-    DFS_stack.push(starting_point);
-    while (DFS_stack.size() > 0)
+    std::vector<std::uint32_t> DFS_stack;
+    steps_taken_[from] = 0;
+    DFS_stack.push_back(from);
+    while (!DFS_stack.empty())
     {
-        Node* top_node = DFS_stack.top();
-        DFS_stack.pop();
-        if(top_node->node_status == WHITE)
+        std::uint32_t top_node = DFS_stack.back();
+        DFS_stack.pop_back();
+        if(node_status_[top_node] == WHITE)
         {
-            top_node->node_status = GRAY;
-            DFS_stack.push(top_node);
-            for(auto neighbour : DFS_stack.top()->accesses)
+            node_status_[top_node] = GRAY;
+            DFS_stack.push_back(top_node);
+            for(std::uint32_t edge = way_graph_.edge_start[top_node]; edge < way_graph_.edge_start[top_node+1]; ++edge)
             {
-                if(nodes_.at(neighbour.first).node_status == WHITE)
+                std::uint32_t neighbour = way_graph_.edge_to[edge];
+                if(node_status_[neighbour] == WHITE)
                 {
-                    nodes_.at(neighbour.first).previous_node = top_node;
-                    nodes_.at(neighbour.first).previous_way = neighbour.second;
-                    nodes_.at(neighbour.first).steps_taken = top_node->steps_taken + 1;
-                    DFS_stack.push(&nodes_.at(neighbour.first));
+                    previous_node_[neighbour] = top_node;
+                    previous_edge_[neighbour] = edge;
+                    steps_taken_[neighbour] = steps_taken_[top_node] + 1;
+                    DFS_stack.push_back(neighbour);
                 }
-                else if(nodes_.at(neighbour.first).node_status == GRAY
-                        and top_node->steps_taken - nodes_.at(neighbour.first).steps_taken > 1) // true cycle found
+                else if(node_status_[neighbour] == GRAY
+                        and steps_taken_[top_node] - steps_taken_[neighbour] > 1) // true cycle found
                 {
-                    nodes_.at(neighbour.first).secondary_previous_node = top_node;
-                    nodes_.at(neighbour.first).secondary_previous_way = neighbour.second;
-                    return &nodes_.at(neighbour.first);
+                    cycle_previous_node = top_node;
+                    cycle_previous_edge = edge;
+                    return neighbour;
                 }
             }
         }
         else
         {
-            top_node->node_status = BLACK;
+            node_status_[top_node] = BLACK;
         }
     }
-    return nullptr;
+    return WayGraph::NO_NODE;
 }
 
-void Datastructures::BFS(Coord &fromxy, Coord &toxy)
+void Datastructures::BFS(std::uint32_t from, std::uint32_t to)
 {
     restore_nodes(); // O(n)
-    std::queue<Node*> BFS_queue;
-    Node* starting_point = &nodes_.at(fromxy);
-    starting_point->node_status = GRAY;
-    starting_point->route_distance_so_far = 0;
-    starting_point->steps_taken = 0;
-    BFS_queue.push(starting_point);
+    std::queue<std::uint32_t> BFS_queue;
+    node_status_[from] = GRAY;
+    route_distance_so_far_[from] = 0;
+    steps_taken_[from] = 0;
+    BFS_queue.push(from);
     // BFS's complexity is O(V+E) in which
     // V is the amount of nodes in a graph, and E
     // the amount of edges in a graph.
     while(BFS_queue.size() > 0)
     {
-        Node* current_node = BFS_queue.front();
+        std::uint32_t current_node = BFS_queue.front();
         BFS_queue.pop();
-        for(auto neighbour : current_node->accesses)
+        for(std::uint32_t edge = way_graph_.edge_start[current_node]; edge < way_graph_.edge_start[current_node+1]; ++edge)
         {
-            if(current_node->location == toxy)
+            if(current_node == to)
             {
-                current_node->node_status = BLACK; // is this necessary?
+                node_status_[current_node] = BLACK; // is this necessary?
                 BFS_queue = {};
                 break;
             }
-            if(nodes_.at(neighbour.first).node_status == WHITE)
+            std::uint32_t neighbour = way_graph_.edge_to[edge];
+            if(node_status_[neighbour] == WHITE)
             {
-                nodes_.at(neighbour.first).node_status = GRAY;
-                nodes_.at(neighbour.first).steps_taken = current_node->steps_taken + 1;
-                nodes_.at(neighbour.first).previous_node = current_node;
-                nodes_.at(neighbour.first).previous_way = neighbour.second;
-                nodes_.at(neighbour.first).route_distance_so_far = current_node->route_distance_so_far +
-                                                                   ways_.at(neighbour.second).distance;
-                BFS_queue.push(&nodes_.at(neighbour.first));
+                node_status_[neighbour] = GRAY;
+                steps_taken_[neighbour] = steps_taken_[current_node] + 1;
+                previous_node_[neighbour] = current_node;
+                previous_edge_[neighbour] = edge;
+                route_distance_so_far_[neighbour] = route_distance_so_far_[current_node] + way_graph_.edge_distance[edge];
+                BFS_queue.push(neighbour);
             }
         }
-        current_node->node_status = BLACK;
+        node_status_[current_node] = BLACK;
     }
 }
 
-std::vector<std::tuple<Coord, WayID, Distance> > Datastructures::track_route(Coord & route_end)
+std::vector<std::tuple<Coord, WayID, Distance> > Datastructures::track_route(std::uint32_t route_end)
 {
     std::vector<std::tuple<Coord, WayID, Distance>> route;
 
-    if(nodes_.at(route_end).previous_node == nullptr) // if this is true, the earlier executed
-    {                                                 //  graph algorithm did not found
-        return route;                                 // a route between points of interest.
+    if(previous_node_[route_end] == WayGraph::NO_NODE) // if this is true, the earlier executed
+    {                                                  //  graph algorithm did not found
+        return route;                                  // a route between points of interest.
     }
 
-    Node* current_node_1 = &nodes_.at(route_end); //.at() is now constant, because the node with Coord toxy exists in nodes_
-    Node* current_node_2 = nodes_.at(route_end).previous_node;
-    route.push_back(std::make_tuple(route_end,NO_WAY,current_node_1->route_distance_so_far)); // .push_back() is amortized constant, std::make_tuple is constant
-
-    while(current_node_1->previous_node != nullptr) // there is no danger of an infinite loop because the route was found,
-    {                                               // otherwise the execution of this method would have ended in the previous if-structure.
-        route.push_back(std::make_tuple(current_node_2->location,current_node_1->previous_way, // And the starting point's node's is
-                                        current_node_2->route_distance_so_far));               // restored and not edited afterwards by DFS, which
-        current_node_1 = current_node_2;                                                       // means that when this while-loop reaches a node
-        current_node_2 = current_node_2->previous_node;                                        // with previous_node == nullptr, the starting node
-    }                                                                                          // is found.
+    std::uint32_t current_node_1 = route_end;
+    std::uint32_t current_node_2 = previous_node_[route_end];
+    route.push_back(std::make_tuple(way_graph_.coords[route_end],NO_WAY,route_distance_so_far_[route_end])); // .push_back() is amortized constant, std::make_tuple is constant
+
+    while(previous_node_[current_node_1] != WayGraph::NO_NODE) // there is no danger of an infinite loop because the route was found,
+    {                                                          // otherwise the execution of this method would have ended in the previous if-structure.
+        route.push_back(std::make_tuple(way_graph_.coords[current_node_2],                               // And the starting point's node's is
+                                        way_graph_.way_ids[way_graph_.edge_way[previous_edge_[current_node_1]]], // restored and not edited afterwards by DFS, which
+                                        route_distance_so_far_[current_node_2]));                        // means that when this while-loop reaches a node
+        current_node_1 = current_node_2;                                                                 // with previous_node == NO_NODE, the starting node
+        current_node_2 = previous_node_[current_node_2];                                                 // is found.
+    }
     // route's data is now in reversed order because
     // we started looping backwards from the target node.
     std::reverse(route.begin(),route.end()); // O(n/2)
     return route;
 }
 
-void Datastructures::A_star(Coord &fromxy, Coord &toxy)
+void Datastructures::A_star(std::uint32_t from, std::uint32_t to)
 {
     restore_nodes(); // O(n)
-    std::priority_queue<std::pair<Distance,Node*>> A_star_queue;
-    Node* starting_point = &nodes_.at(fromxy);
-    starting_point->route_distance_so_far = 0;
-    Distance shortest_possible_distance = distance_between_nodes(fromxy, toxy);
-    starting_point->node_status = GRAY;
-    A_star_queue.push(std::make_pair(shortest_possible_distance*-1,starting_point));
+    // Ties are broken by the larger node number, which is the order of the
+    // addresses of the nodes in nodes_ the searches used before way_graph_.
+    std::priority_queue<std::pair<Distance,std::uint32_t>> A_star_queue;
+    Coord toxy = way_graph_.coords[to];
+    route_distance_so_far_[from] = 0;
+    Distance shortest_possible_distance = distance_between_nodes(way_graph_.coords[from], toxy);
+    node_status_[from] = GRAY;
+    A_star_queue.push(std::make_pair(shortest_possible_distance*-1,from));
     while(A_star_queue.size() != 0)
     {
-        Node* current_node = A_star_queue.top().second;
+        std::uint32_t current_node = A_star_queue.top().second;
         A_star_queue.pop();
-        if(current_node->location == toxy)
+        if(current_node == to)
         {
-            A_star_queue = {};
             break;
         }
-        if(current_node->node_status == BLACK)
+        if(node_status_[current_node] == BLACK)
         {
             continue; // to check duplicates
         }
-        for(auto neighbour : current_node->accesses)
+        for(std::uint32_t edge = way_graph_.edge_start[current_node]; edge < way_graph_.edge_start[current_node+1]; ++edge)
         {
-            if(nodes_.at(neighbour.first).node_status == WHITE)
-            {
-                nodes_.at(neighbour.first).node_status = GRAY;
-
-                nodes_.at(neighbour.first).route_distance_so_far = current_node->route_distance_so_far +
-                                                                   ways_.at(neighbour.second).distance;
-
-                nodes_.at(neighbour.first).route_distance_estimate = nodes_.at(neighbour.first).route_distance_so_far +
-                        distance_between_nodes(neighbour.first,toxy);
-
-                nodes_.at(neighbour.first).previous_way = neighbour.second;
-                nodes_.at(neighbour.first).previous_node = current_node;
-
-                A_star_queue.push(std::make_pair(nodes_.at(neighbour.first).route_distance_estimate*-1
-                                                 ,&nodes_.at(neighbour.first)));
-            }
-            else if(nodes_.at(neighbour.first).route_distance_so_far > current_node->route_distance_so_far +
-                                                                  ways_.at(neighbour.second).distance)
+            std::uint32_t neighbour = way_graph_.edge_to[edge];
+            Distance distance = route_distance_so_far_[current_node] + way_graph_.edge_distance[edge];
+            if(node_status_[neighbour] == WHITE or route_distance_so_far_[neighbour] > distance)
             {
-                nodes_.at(neighbour.first).route_distance_so_far = current_node->route_distance_so_far +
-                                                                   ways_.at(neighbour.second).distance;
-                nodes_.at(neighbour.first).route_distance_estimate = nodes_.at(neighbour.first).route_distance_so_far +
-                                                                   distance_between_nodes(neighbour.first,toxy);
-                nodes_.at(neighbour.first).previous_way = neighbour.second;
-                nodes_.at(neighbour.first).previous_node = current_node;
-
-                A_star_queue.push(std::make_pair(nodes_.at(neighbour.first).route_distance_estimate*-1
-                                                 ,&nodes_.at(neighbour.first)));
+                node_status_[neighbour] = node_status_[neighbour] == WHITE ? GRAY : node_status_[neighbour];
+                route_distance_so_far_[neighbour] = distance;
+                previous_edge_[neighbour] = edge;
+                previous_node_[neighbour] = current_node;
+                Distance route_distance_estimate = distance + distance_between_nodes(way_graph_.coords[neighbour],toxy);
+                A_star_queue.push(std::make_pair(route_distance_estimate*-1,neighbour));
             }
         }
-        current_node->node_status = BLACK;
+        node_status_[current_node] = BLACK;
     }
 }
 
-void Datastructures::Dijkstra(Coord fromxy, bool restoreNodes)
+void Datastructures::Dijkstra(std::uint32_t from, bool restoreNodes)
 {
     if(restoreNodes)
     {
          restore_nodes();
     }
-    std::priority_queue<std::pair<Distance,Node*>> Dijkstra_queue;
-    nodes_.at(fromxy).node_status = GRAY;
-    nodes_.at(fromxy).route_distance_so_far = 0;
-    Dijkstra_queue.push(std::make_pair(0,&nodes_.at(fromxy)));
+    std::priority_queue<std::pair<Distance,std::uint32_t>> Dijkstra_queue;
+    node_status_[from] = GRAY;
+    route_distance_so_far_[from] = 0;
+    Dijkstra_queue.push(std::make_pair(0,from));
     while (Dijkstra_queue.size() != 0)
     {
-        Node* current_node = Dijkstra_queue.top().second;
+        std::uint32_t current_node = Dijkstra_queue.top().second;
         Dijkstra_queue.pop();
-        if(current_node->node_status == BLACK)
+        if(node_status_[current_node] == BLACK)
         {
             continue; // to check duplicates
         }
-        for(auto neighbour : current_node->accesses)
+        for(std::uint32_t edge = way_graph_.edge_start[current_node]; edge < way_graph_.edge_start[current_node+1]; ++edge)
         {
-            if(nodes_.at(neighbour.first).node_status == WHITE)
-            {
-                nodes_.at(neighbour.first).node_status = GRAY;
-                nodes_.at(neighbour.first).route_distance_so_far = current_node->route_distance_so_far
-                                                                 + ways_.at(neighbour.second).distance;
-                nodes_.at(neighbour.first).previous_node = current_node;
-                nodes_.at(neighbour.first).previous_way = neighbour.second;
-                Dijkstra_queue.push(std::make_pair(nodes_.at(neighbour.first).route_distance_so_far*-1,&nodes_.at(neighbour.first)));
-            }
-            else if(nodes_.at(neighbour.first).route_distance_so_far > current_node->route_distance_so_far
-                                                                  + ways_.at(neighbour.second).distance)
+            std::uint32_t neighbour = way_graph_.edge_to[edge];
+            Distance distance = route_distance_so_far_[current_node] + way_graph_.edge_distance[edge];
+            if(node_status_[neighbour] == WHITE or route_distance_so_far_[neighbour] > distance)
             {
-                nodes_.at(neighbour.first).route_distance_so_far = current_node->route_distance_so_far
-                                                                 + ways_.at(neighbour.second).distance;
-                nodes_.at(neighbour.first).previous_node = current_node;
-                nodes_.at(neighbour.first).previous_way = neighbour.second;
-                Dijkstra_queue.push(std::make_pair(nodes_.at(neighbour.first).route_distance_so_far*-1,&nodes_.at(neighbour.first)));
+                node_status_[neighbour] = node_status_[neighbour] == WHITE ? GRAY : node_status_[neighbour];
+                route_distance_so_far_[neighbour] = distance;
+                previous_node_[neighbour] = current_node;
+                previous_edge_[neighbour] = edge;
+                Dijkstra_queue.push(std::make_pair(distance*-1,neighbour));
             }
         }
-        current_node->node_status = BLACK;
+        node_status_[current_node] = BLACK;
     }
 }
 
 
 bool Datastructures::remove_way(WayID id)
 {
+    build_deferred_indexes_();
     if(ways_.find(id) == ways_.end()) // find() constant on average, linear on worst case, end() is constant
     {
         return false;
@@ -882,56 +3597,66 @@ bool Datastructures::remove_way(WayID id)
     nodes_.at(ways_.at(id).coordinates.front()).accesses.erase(ways_.at(id).coordinates.back());   // average: constant
     nodes_.at(ways_.at(id).coordinates.back()).accesses.erase((ways_.at(id).coordinates.front()));   // worst case: linear
     ways_.erase(id);
+    way_graph_valid_ = false;
     return true;
 }
 
 std::vector<std::tuple<Coord, WayID, Distance> > Datastructures::route_least_crossroads(Coord fromxy, Coord toxy)
 {
-    if(nodes_.find(fromxy) == nodes_.end() or
-            nodes_.find(toxy) == nodes_.end()) // for unordered_map .find() is constant on average, linear on worst case, .end() constant
+    build_deferred_indexes_();
+    freeze_way_graph_();
+    std::uint32_t from = way_graph_.find(fromxy); // O(log n)
+    std::uint32_t to = way_graph_.find(toxy);
+    if(from == WayGraph::NO_NODE or to == WayGraph::NO_NODE)
     {
         return {{NO_COORD, NO_WAY, NO_DISTANCE}}; // one or both of coordinates were not nodes.
     }
 
-    if(nodes_.at(fromxy).accesses.size() < 1 or
-       nodes_.at(toxy).accesses.size() < 1) // for unordered_map .find() .at() constant on average, worst case linear,
+    if(way_graph_.edge_start[from] == way_graph_.edge_start[from+1] or
+       way_graph_.edge_start[to] == way_graph_.edge_start[to+1])
     {
           return {{NO_COORD, NO_WAY, NO_DISTANCE}}; // one or both of nodes were not crossroads.
     }
 
-    BFS(fromxy,toxy); // O(n) (O(V+E)).
-    return track_route(toxy); // O(n)
+    BFS(from,to); // O(n) (O(V+E)).
+    return track_route(to); // O(n)
 }
 
 std::vector<std::tuple<Coord, WayID> > Datastructures::route_with_cycle(Coord fromxy)
 {
-    if(nodes_.find(fromxy) == nodes_.end()) // for unordered_map .find() is constant on average, linear on worst case, .end() constant
+    build_deferred_indexes_();
+    freeze_way_graph_();
+    std::uint32_t from = way_graph_.find(fromxy); // O(log n)
+    if(from == WayGraph::NO_NODE)
     {
         return {{NO_COORD, NO_WAY}}; // given coordinate was not a node
     }
 
-    if(nodes_.at(fromxy).accesses.size() < 1) // for unordered_map .find() .at() constant on average, worst case linear,
+    if(way_graph_.edge_start[from] == way_graph_.edge_start[from+1])
     {
           return {{NO_COORD, NO_WAY}}; // given node was not a crossroad
     }
-    Node* cycle_node = DFS_cycle(fromxy);
+    std::uint32_t cycle_previous_node = WayGraph::NO_NODE;
+    std::uint32_t cycle_previous_edge = WayGraph::NO_EDGE;
+    std::uint32_t cycle_node = DFS_cycle(from,cycle_previous_node,cycle_previous_edge);
     std::vector<std::tuple<Coord, WayID>> cycle_route;
-    if(cycle_node == nullptr) //cycle was not found
+    if(cycle_node == WayGraph::NO_NODE) //cycle was not found
     {
         return cycle_route;
     }
 
-    cycle_route.push_back(std::make_tuple(cycle_node->location,NO_WAY));
-    cycle_route.push_back(std::make_tuple(cycle_node->secondary_previous_node->location,
-                                          cycle_node->secondary_previous_way));
-    Node* current_node_1 = cycle_node->secondary_previous_node;
-    Node* current_node_2 = cycle_node->secondary_previous_node->previous_node;
+    cycle_route.push_back(std::make_tuple(way_graph_.coords[cycle_node],NO_WAY));
+    cycle_route.push_back(std::make_tuple(way_graph_.coords[cycle_previous_node],
+                                          way_graph_.way_ids[way_graph_.edge_way[cycle_previous_edge]]));
+    std::uint32_t current_node_1 = cycle_previous_node;
+    std::uint32_t current_node_2 = previous_node_[cycle_previous_node];
 
-    while(current_node_1->previous_node != nullptr)
+    while(previous_node_[current_node_1] != WayGraph::NO_NODE)
     {
-        cycle_route.push_back(std::make_tuple(current_node_2->location,current_node_1->previous_way));
+        cycle_route.push_back(std::make_tuple(way_graph_.coords[current_node_2],
+                                              way_graph_.way_ids[way_graph_.edge_way[previous_edge_[current_node_1]]]));
         current_node_1 = current_node_2;
-        current_node_2 = current_node_2->previous_node;
+        current_node_2 = previous_node_[current_node_2];
     }
 
     std::reverse(cycle_route.begin(),cycle_route.end());
@@ -940,62 +3665,68 @@ std::vector<std::tuple<Coord, WayID> > Datastructures::route_with_cycle(Coord fr
 
 std::vector<std::tuple<Coord, WayID, Distance> > Datastructures::route_shortest_distance(Coord fromxy, Coord toxy)
 {
-    if(nodes_.find(fromxy) == nodes_.end() or
-            nodes_.find(toxy) == nodes_.end()) // for unordered_map .find() is constant on average, linear on worst case, .end() constant
+    build_deferred_indexes_();
+    freeze_way_graph_();
+    std::uint32_t from = way_graph_.find(fromxy); // O(log n)
+    std::uint32_t to = way_graph_.find(toxy);
+    if(from == WayGraph::NO_NODE or to == WayGraph::NO_NODE)
     {
         return {{NO_COORD, NO_WAY, NO_DISTANCE}}; // one or both of coordinates were not nodes.
     }
 
-    if(nodes_.at(fromxy).accesses.size() < 1 or
-       nodes_.at(toxy).accesses.size() < 1) // for unordered_map .find() .at() constant on average, worst case linear,
+    if(way_graph_.edge_start[from] == way_graph_.edge_start[from+1] or
+       way_graph_.edge_start[to] == way_graph_.edge_start[to+1])
     {
           return {{NO_COORD, NO_WAY, NO_DISTANCE}}; // one or both of nodes were not crossroads.
     }
-    A_star(fromxy,toxy);
-    return track_route(toxy);
+    A_star(from,to);
+    return track_route(to);
 }
 
 Distance Datastructures::trim_ways()
 {
-    std::pair<Coord,Node> seed = *nodes_.begin();
-    Coord seed_coord = seed.first;
-    Dijkstra(seed_coord,true);
+    build_deferred_indexes_();
+    freeze_way_graph_();
+    if(way_graph_.node_count() == 0)
+    {
+        return 0;
+    }
+    // The seed is the first node of nodes_.
+    Dijkstra(0,true);
     // O(n*n*logn)).
-    for(auto crossroad : nodes_)
+    for(std::uint32_t crossroad = 0; crossroad < way_graph_.node_count(); ++crossroad)
     {
-        if(crossroad.second.previous_way == NO_WAY)
+        if(previous_edge_[crossroad] == WayGraph::NO_EDGE)
         {
-            Dijkstra(crossroad.first,false); // if entered here, there were a point of discontinuity in the graph.
+            Dijkstra(crossroad,false); // if entered here, there were a point of discontinuity in the graph.
         }   // and by doing this we ensure the whole graph gets handled.
     }
-    // O(n) averagely.
-    std::unordered_set<WayID> ways_to_be_saved;
-    for(auto crossroad : nodes_)
-    {
-        ways_to_be_saved.insert(crossroad.second.previous_way);
-    }
-    // O(n) averagely.
-    for(auto way : ways_)
+    // O(n). The ways are indexes to way_graph_.way_ids.
+    std::vector<bool> ways_to_be_saved(way_graph_.way_ids.size(),false);
+    for(std::uint32_t edge : previous_edge_)
     {
-        if(ways_to_be_saved.find(way.first) == ways_to_be_saved.end())
+        if(edge != WayGraph::NO_EDGE)
         {
-            remove_way(way.first);
+            ways_to_be_saved[way_graph_.edge_way[edge]] = true;
         }
     }
-    // O(n) averagely.
-    for(auto node : nodes_)
+    // O(n) averagely. The ways are removed only after the loop, because
+    // removing elements from ways_ while looping through it would invalidate the loop.
+    std::vector<WayID> ways_to_be_removed;
+    for(std::size_t way = 0; way < way_graph_.way_ids.size(); ++way)
     {
-        for(auto access : node.second.accesses)
+        if(!ways_to_be_saved[way])
         {
-            if(ways_to_be_saved.find(access.second) == ways_to_be_saved.end())
-            {
-                node.second.accesses.erase(access.first);
-            }
+            ways_to_be_removed.push_back(way_graph_.way_ids[way]);
         }
     }
+    for(auto const& way_id : ways_to_be_removed)
+    {
+        remove_way(way_id);
+    }
     // O(n) averagely.
     Distance network_distance = 0;
-    for(auto way : ways_)
+    for(auto const& way : ways_)
     {
         network_distance += way.second.distance;
     }
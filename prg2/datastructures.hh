@@ -16,6 +16,13 @@
 #include <set>
 #include <map>
 #include <memory>
+#include <array>
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+#include <string_view>
+#include <cstring>
 
 // Types for IDs
 using PlaceID = long long int;
@@ -51,15 +58,37 @@ struct Coord
 inline bool operator==(Coord c1, Coord c2) { return c1.x == c2.x && c1.y == c2.y; }
 inline bool operator!=(Coord c1, Coord c2) { return !(c1==c2); } // Not strictly necessary
 
+// 64-bit hash mixer (the finalizer of splitmix64). IDs and coordinates that are
+// close to each other differ only in their lowest bits, and mixing spreads the
+// differences to all bits, which is needed when a table takes only the lowest
+// bits of a hash (as FlatHashMap does).
+inline std::uint64_t mix_hash(std::uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+// Hash function for PlaceID and AreaID
+struct IdHash
+{
+    std::size_t operator()(long long int id) const
+    {
+        return mix_hash(static_cast<std::uint64_t>(id));
+    }
+};
+
 struct CoordHash
 {
     std::size_t operator()(Coord xy) const
     {
-        auto hasher = std::hash<int>();
-        auto xhash = hasher(xy.x);
-        auto yhash = hasher(xy.y);
-        // Combine hash values (magic!)
-        return xhash ^ (yhash + 0x9e3779b9 + (xhash << 6) + (xhash >> 2));
+        // Both coordinates are packed to one 64-bit value, which is then mixed.
+        std::uint64_t packed = (static_cast<std::uint64_t>(static_cast<std::uint32_t>(xy.x)) << 32) |
+                               static_cast<std::uint32_t>(xy.y);
+        return mix_hash(packed);
     }
 };
 
@@ -81,19 +110,805 @@ using Distance = int;
 // Return value for cases where Duration is unknown
 Distance const NO_DISTANCE = NO_VALUE;
 
-enum Status {WHITE, GRAY, BLACK};
+// Type for the size of an area (in squared coordinate units)
+using AreaSize = double;
+
+// Return value for cases where the size of an area is unknown
+AreaSize const NO_AREA_SIZE = NO_VALUE;
+
+// Hash table with open addressing, used instead of std::unordered_map for the main
+// containers. The elements are stored in one array without per-element allocations,
+// and collisions are resolved by linear probing with Robin Hood ordering: an element
+// that is further from its home slot takes the slot of one that is closer to its own.
+// This keeps probe sequences short, so that a lookup can stop as soon as it meets an
+// element closer to its home than the searched key would be. The probe distances are
+// kept in a separate small array, so most probes do not touch the elements at all.
+// Erasing shifts the following elements back instead of leaving tombstones.
+// NOTE: Unlike with std::unordered_map, inserting or erasing elements moves other
+// elements, so pointers, references and iterators to the elements are invalidated.
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class FlatHashMap
+{
+public:
+    using key_type = Key;
+    using mapped_type = Value;
+    using value_type = std::pair<Key,Value>;
+
+    template <bool IsConst>
+    class Iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = FlatHashMap::value_type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = std::conditional_t<IsConst, value_type const*, value_type*>;
+        using reference = std::conditional_t<IsConst, value_type const&, value_type&>;
+        using Map = std::conditional_t<IsConst, FlatHashMap const, FlatHashMap>;
+
+        Iterator() = default;
+        Iterator(Map* map, std::size_t index) : map_(map), index_(index) {}
+        operator Iterator<true>() const { return Iterator<true>(map_,index_); }
+
+        reference operator*() const { return map_->slots_[index_].value; }
+        pointer operator->() const { return &map_->slots_[index_].value; }
+        Iterator& operator++()
+        {
+            index_ = map_->next_occupied_(index_+1);
+            return *this;
+        }
+        Iterator operator++(int)
+        {
+            Iterator old = *this;
+            ++*this;
+            return old;
+        }
+        template <bool OtherIsConst>
+        bool operator==(Iterator<OtherIsConst> const& other) const { return index_ == other.index_; }
+        template <bool OtherIsConst>
+        bool operator!=(Iterator<OtherIsConst> const& other) const { return index_ != other.index_; }
+
+    private:
+        friend class FlatHashMap;
+        template <bool> friend class Iterator;
+        Map* map_ = nullptr;
+        std::size_t index_ = 0;
+    };
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    FlatHashMap() = default;
+    FlatHashMap(FlatHashMap const& other);
+    FlatHashMap(FlatHashMap&& other) noexcept;
+    FlatHashMap& operator=(FlatHashMap other) noexcept;
+    ~FlatHashMap();
+
+    iterator begin() { return iterator(this,next_occupied_(0)); }
+    iterator end() { return iterator(this,capacity_); }
+    const_iterator begin() const { return const_iterator(this,next_occupied_(0)); }
+    const_iterator end() const { return const_iterator(this,capacity_); }
+
+    std::size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    // Estimate of performance: Linear in the capacity of the table.
+    // Short rationale for estimate: Every slot is checked and the elements destroyed.
+    // The capacity is kept, like .clear() of std::unordered_map keeps its buckets.
+    void clear();
+
+    // Estimate of performance: Linear in the amount of elements.
+    // Short rationale for estimate: The elements are moved to a table large
+    // enough for count elements, if the current one is not.
+    void reserve(std::size_t count);
+
+    // Estimate of performance: Constant on average.
+    // Short rationale for estimate: The key is searched from its home slot onwards,
+    // and Robin Hood ordering keeps the probe sequences short.
+    iterator find(Key const& key);
+    const_iterator find(Key const& key) const;
+    std::size_t count(Key const& key) const { return find(key) == end() ? 0 : 1; }
+
+    // Estimate of performance: Constant on average.
+    // Short rationale for estimate: Like find(). Throws std::out_of_range if the key is not found.
+    Value& at(Key const& key);
+    Value const& at(Key const& key) const;
+
+    // Estimate of performance: Amortized constant on average.
+    // Short rationale for estimate: Like find(), and when the key is not found the new
+    // element is placed with Robin Hood swaps. The table is doubled when it gets 7/8 full,
+    // which is amortized constant.
+    Value& operator[](Key const& key);
+    std::pair<iterator,bool> insert(value_type const& value);
+    std::pair<iterator,bool> insert(value_type&& value);
+
+    // Estimate of performance: Constant on average.
+    // Short rationale for estimate: Like find(), and the following elements of the
+    // probe sequence (few on average) are shifted back by one slot.
+    std::size_t erase(Key const& key);
+    void erase(const_iterator position);
 
-struct Place
+private:
+    struct Slot
+    {
+        Slot() {}
+        ~Slot() {}
+        union { value_type value; }; // constructed only in occupied slots
+    };
+
+    // Probe distances are stored as 16-bit values, 0 meaning an empty slot.
+    using Distance = std::uint16_t;
+    static constexpr Distance MAX_DISTANCE = std::numeric_limits<Distance>::max();
+
+    std::size_t next_occupied_(std::size_t index) const;
+    std::size_t find_index_(Key const& key) const;
+    template <typename K, typename... Args>
+    std::pair<iterator,bool> emplace_(K&& key, Args&&... args);
+    std::size_t place_(value_type&& entry);
+    void erase_index_(std::size_t index);
+    void rehash_(std::size_t new_capacity);
+
+    std::unique_ptr<Slot[]> slots_;
+    std::unique_ptr<Distance[]> distances_; // probe distance + 1 of the element in each slot
+    std::size_t capacity_ = 0; // a power of two, or 0 before the first insertion
+    std::size_t size_ = 0;
+    Hash hash_;
+};
+
+template <typename Key, typename Value, typename Hash>
+FlatHashMap<Key,Value,Hash>::FlatHashMap(FlatHashMap const& other)
 {
-    Name placeName;
-    PlaceType type;
-    Coord location;
+    reserve(other.size_);
+    for (auto const& element : other)
+    {
+        insert(element);
+    }
+}
+
+template <typename Key, typename Value, typename Hash>
+FlatHashMap<Key,Value,Hash>::FlatHashMap(FlatHashMap&& other) noexcept
+    : slots_(std::move(other.slots_)), distances_(std::move(other.distances_)),
+      capacity_(other.capacity_), size_(other.size_), hash_(std::move(other.hash_))
+{
+    other.capacity_ = 0;
+    other.size_ = 0;
+}
+
+template <typename Key, typename Value, typename Hash>
+FlatHashMap<Key,Value,Hash>& FlatHashMap<Key,Value,Hash>::operator=(FlatHashMap other) noexcept
+{
+    std::swap(slots_,other.slots_);
+    std::swap(distances_,other.distances_);
+    std::swap(capacity_,other.capacity_);
+    std::swap(size_,other.size_);
+    std::swap(hash_,other.hash_);
+    return *this;
+}
+
+template <typename Key, typename Value, typename Hash>
+FlatHashMap<Key,Value,Hash>::~FlatHashMap()
+{
+    clear();
+}
+
+template <typename Key, typename Value, typename Hash>
+void FlatHashMap<Key,Value,Hash>::clear()
+{
+    for (std::size_t i = 0; i < capacity_ && size_ > 0; ++i)
+    {
+        if (distances_[i] != 0)
+        {
+            slots_[i].value.~value_type();
+            distances_[i] = 0;
+            --size_;
+        }
+    }
+}
+
+template <typename Key, typename Value, typename Hash>
+void FlatHashMap<Key,Value,Hash>::reserve(std::size_t count)
+{
+    std::size_t new_capacity = capacity_ == 0 ? 16 : capacity_;
+    while (count*8 > new_capacity*7)
+    {
+        new_capacity *= 2;
+    }
+    if (new_capacity != capacity_)
+    {
+        rehash_(new_capacity);
+    }
+}
+
+template <typename Key, typename Value, typename Hash>
+typename FlatHashMap<Key,Value,Hash>::iterator FlatHashMap<Key,Value,Hash>::find(Key const& key)
+{
+    return iterator(this,find_index_(key));
+}
+
+template <typename Key, typename Value, typename Hash>
+typename FlatHashMap<Key,Value,Hash>::const_iterator FlatHashMap<Key,Value,Hash>::find(Key const& key) const
+{
+    return const_iterator(this,find_index_(key));
+}
+
+template <typename Key, typename Value, typename Hash>
+Value& FlatHashMap<Key,Value,Hash>::at(Key const& key)
+{
+    std::size_t index = find_index_(key);
+    if (index == capacity_)
+    {
+        throw std::out_of_range("FlatHashMap::at");
+    }
+    return slots_[index].value.second;
+}
+
+template <typename Key, typename Value, typename Hash>
+Value const& FlatHashMap<Key,Value,Hash>::at(Key const& key) const
+{
+    std::size_t index = find_index_(key);
+    if (index == capacity_)
+    {
+        throw std::out_of_range("FlatHashMap::at");
+    }
+    return slots_[index].value.second;
+}
+
+template <typename Key, typename Value, typename Hash>
+Value& FlatHashMap<Key,Value,Hash>::operator[](Key const& key)
+{
+    return emplace_(key).first->second;
+}
+
+template <typename Key, typename Value, typename Hash>
+std::pair<typename FlatHashMap<Key,Value,Hash>::iterator,bool> FlatHashMap<Key,Value,Hash>::insert(value_type const& value)
+{
+    return emplace_(value.first,value.second);
+}
+
+template <typename Key, typename Value, typename Hash>
+std::pair<typename FlatHashMap<Key,Value,Hash>::iterator,bool> FlatHashMap<Key,Value,Hash>::insert(value_type&& value)
+{
+    return emplace_(std::move(value.first),std::move(value.second));
+}
+
+template <typename Key, typename Value, typename Hash>
+std::size_t FlatHashMap<Key,Value,Hash>::erase(Key const& key)
+{
+    std::size_t index = find_index_(key);
+    if (index == capacity_)
+    {
+        return 0;
+    }
+    erase_index_(index);
+    return 1;
+}
+
+template <typename Key, typename Value, typename Hash>
+void FlatHashMap<Key,Value,Hash>::erase(const_iterator position)
+{
+    erase_index_(position.index_);
+}
+
+template <typename Key, typename Value, typename Hash>
+std::size_t FlatHashMap<Key,Value,Hash>::next_occupied_(std::size_t index) const
+{
+    while (index < capacity_ && distances_[index] == 0)
+    {
+        ++index;
+    }
+    return index;
+}
+
+template <typename Key, typename Value, typename Hash>
+std::size_t FlatHashMap<Key,Value,Hash>::find_index_(Key const& key) const
+{
+    if (size_ == 0)
+    {
+        return capacity_;
+    }
+    std::size_t mask = capacity_-1;
+    std::size_t index = hash_(key) & mask;
+    for (Distance distance = 1; ; ++distance, index = (index+1) & mask)
+    {
+        // An empty slot (0), or an element closer to its home than the key would be,
+        // means that the key is not in the table.
+        if (distances_[index] < distance)
+        {
+            return capacity_;
+        }
+        if (distances_[index] == distance && slots_[index].value.first == key)
+        {
+            return index;
+        }
+    }
+}
+
+template <typename Key, typename Value, typename Hash>
+template <typename K, typename... Args>
+std::pair<typename FlatHashMap<Key,Value,Hash>::iterator,bool> FlatHashMap<Key,Value,Hash>::emplace_(K&& key, Args&&... args)
+{
+    std::size_t index = find_index_(key);
+    if (index != capacity_)
+    {
+        return {iterator(this,index),false};
+    }
+    if ((size_+1)*8 > capacity_*7)
+    {
+        rehash_(capacity_ == 0 ? 16 : 2*capacity_);
+    }
+    index = place_(value_type(std::piecewise_construct,
+                              std::forward_as_tuple(std::forward<K>(key)),
+                              std::forward_as_tuple(std::forward<Args>(args)...)));
+    ++size_;
+    return {iterator(this,index),true};
+}
+
+template <typename Key, typename Value, typename Hash>
+std::size_t FlatHashMap<Key,Value,Hash>::place_(value_type&& entry)
+{
+    std::size_t mask = capacity_-1;
+    std::size_t index = hash_(entry.first) & mask;
+    std::size_t placed = capacity_; // where the original entry was put, if it has been swapped out
+    // entry is the element in hand: first the one being placed, and after a Robin Hood swap
+    // the one that gave way to it.
+    for (Distance distance = 1; ; ++distance, index = (index+1) & mask)
+    {
+        if (distances_[index] == 0)
+        {
+            new (&slots_[index].value) value_type(std::move(entry));
+            distances_[index] = distance;
+            return placed == capacity_ ? index : placed;
+        }
+        if (distances_[index] < distance)
+        {
+            // Robin Hood: the element closer to its home slot gives way and is
+            // carried further instead.
+            std::swap(entry,slots_[index].value);
+            std::swap(distance,distances_[index]);
+            if (placed == capacity_)
+            {
+                placed = index;
+            }
+        }
+        if (distance == MAX_DISTANCE-1)
+        {
+            // Probe sequences this long should not happen with a good hash function,
+            // but if one does, the table is grown and the element in hand placed again.
+            // If the table is already mostly empty, growing would not help, as the
+            // hash function gives the same value to too many keys.
+            if (capacity_ > 8*size_)
+            {
+                throw std::length_error("FlatHashMap: too many keys with the same hash value");
+            }
+            if (placed == capacity_)
+            {
+                rehash_(2*capacity_);
+                return place_(std::move(entry));
+            }
+            Key placed_key = slots_[placed].value.first;
+            rehash_(2*capacity_);
+            place_(std::move(entry));
+            return find_index_(placed_key);
+        }
+    }
+}
+
+template <typename Key, typename Value, typename Hash>
+void FlatHashMap<Key,Value,Hash>::erase_index_(std::size_t index)
+{
+    // Backward shift: the following elements that are not in their home slot
+    // are moved one slot back, so no tombstones are needed.
+    std::size_t mask = capacity_-1;
+    slots_[index].value.~value_type();
+    std::size_t next = (index+1) & mask;
+    while (distances_[next] > 1)
+    {
+        new (&slots_[index].value) value_type(std::move(slots_[next].value));
+        slots_[next].value.~value_type();
+        distances_[index] = distances_[next]-1;
+        index = next;
+        next = (next+1) & mask;
+    }
+    distances_[index] = 0;
+    --size_;
+}
+
+template <typename Key, typename Value, typename Hash>
+void FlatHashMap<Key,Value,Hash>::rehash_(std::size_t new_capacity)
+{
+    std::unique_ptr<Slot[]> old_slots = std::move(slots_);
+    std::unique_ptr<Distance[]> old_distances = std::move(distances_);
+    std::size_t old_capacity = capacity_;
+
+    slots_.reset(new Slot[new_capacity]);
+    distances_.reset(new Distance[new_capacity]());
+    capacity_ = new_capacity;
+    for (std::size_t i = 0; i < old_capacity; ++i)
+    {
+        if (old_distances[i] != 0)
+        {
+            place_(std::move(old_slots[i].value));
+            old_slots[i].value.~value_type();
+        }
+    }
+}
+
+// The main containers of Datastructures use FlatHashMap. Uncomment the define of
+// USE_STD_UNORDERED_MAP in prg2.pro to use std::unordered_map instead, for example to
+// compare the two with perftest.
+#ifdef USE_STD_UNORDERED_MAP
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+using HashMap = std::unordered_map<Key,Value,Hash>;
+#else
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+using HashMap = FlatHashMap<Key,Value,Hash>;
+#endif
+
+// View to count consecutive elements stored elsewhere (e.g. in a MonotonicArena).
+// A Span does not own the elements, so copying it copies only the pointer and size.
+template <typename T>
+class Span
+{
+public:
+    Span() = default;
+    Span(T* data, std::size_t size) : data_(data), size_(size) {}
+
+    T* begin() const { return data_; }
+    T* end() const { return data_+size_; }
+    T* data() const { return data_; }
+    std::size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    T& operator[](std::size_t index) const { return data_[index]; }
+    T& front() const { return data_[0]; }
+    T& back() const { return data_[size_-1]; }
+
+private:
+    T* data_ = nullptr;
+    std::size_t size_ = 0;
 };
 
+// Monotonic arena for data that does not change after it has been added (names,
+// area shapes and way coordinates). Memory is handed out from large blocks by just
+// advancing a position, and single allocations are never freed. Instead all memory
+// of the arena is released at once with release(), e.g. when the data is cleared.
+// This replaces thousands of small heap allocations with a few large ones and keeps
+// the data of one dataset close together in memory.
+class MonotonicArena
+{
+public:
+    MonotonicArena() = default;
+    MonotonicArena(MonotonicArena const&) = delete;
+    MonotonicArena& operator=(MonotonicArena const&) = delete;
+
+    // Estimate of performance: Constant (amortized over the allocated bytes).
+    // Short rationale for estimate: The position in the current block is advanced.
+    // A new block is allocated only when the current one is full, and the blocks
+    // grow in size so that their amount stays logarithmic.
+    void* allocate(std::size_t bytes, std::size_t alignment);
+
+    // Estimate of performance: Linear in count.
+    // Short rationale for estimate: The elements are allocated with allocate()
+    // and copied with memcpy. Only for trivially copyable types.
+    template <typename T>
+    Span<T const> copy(T const* data, std::size_t count)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "MonotonicArena does not run destructors");
+        if (count == 0)
+        {
+            return {};
+        }
+        T* copied = static_cast<T*>(allocate(count*sizeof(T),alignof(T)));
+        std::memcpy(copied,data,count*sizeof(T));
+        return {copied,count};
+    }
+
+    // Estimate of performance: Linear in the amount of blocks.
+    // Short rationale for estimate: Every block is freed once.
+    // All Spans to the arena are invalid after this.
+    void release();
+
+    // Estimate of performance: Constant.
+    // Short rationale for estimate: size() for vector.
+    std::size_t block_count() const;
+
+private:
+    static constexpr std::size_t FIRST_BLOCK_SIZE = 16*1024;
+    static constexpr std::size_t MAX_BLOCK_SIZE = 4*1024*1024;
+
+    std::vector<std::unique_ptr<char[]>> blocks_;
+    char* position_ = nullptr;
+    std::size_t remaining_ = 0;
+    std::size_t next_block_size_ = FIRST_BLOCK_SIZE;
+};
+
+// Shape of an area stored compressed in a MonotonicArena: every coordinate is stored
+// as its difference from the previous one (the first from (0,0)), and the x and y
+// differences are zigzag encoded (0,-1,1,-2,... to 0,1,2,3,...) and written as varints
+// (7 bits per byte, the highest bit tells if more bytes follow). Neighbouring points of
+// a shape are usually close to each other, so most coordinates take two bytes instead
+// of eight. The coordinates are decoded while they are read, with ShapeDecoder or with
+// the iterators, which decode one coordinate per step.
+class PackedShape
+{
+public:
+    class const_iterator;
+
+    PackedShape() = default;
+    PackedShape(std::uint8_t const* data, std::uint32_t size) : data_(data), size_(size) {}
+
+    // Estimate of performance: Linear in count.
+    // Short rationale for estimate: The coordinates are gone through twice, first to
+    // count the bytes and then to write them to memory allocated once from arena.
+    static PackedShape encode(Coord const* coords, std::size_t count, MonotonicArena & arena);
+
+    // Estimate of performance: Linear in size().
+    // Short rationale for estimate: All coordinates are decoded once to out, which must
+    // have room for size() coordinates.
+    void decode(Coord* out) const;
+
+    std::uint8_t const* data() const { return data_; }
+    std::size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    Coord front() const;
+    const_iterator begin() const;
+    const_iterator end() const;
+
+private:
+    std::uint8_t const* data_ = nullptr;
+    std::uint32_t size_ = 0;
+};
+
+// Streaming decoder of a PackedShape: returns the coordinates in order, one at a time
+// or a block at a time, without decoding the rest of the shape.
+class ShapeDecoder
+{
+public:
+    ShapeDecoder() = default;
+    explicit ShapeDecoder(PackedShape const& shape) : position_(shape.data()), remaining_(shape.size()) {}
+
+    bool done() const { return remaining_ == 0; }
+
+    // Estimate of performance: Constant.
+    // Short rationale for estimate: Reads two varints of at most 10 bytes each.
+    // Must not be called when done().
+    Coord next()
+    {
+        previous_.x = static_cast<int>(previous_.x + unzigzag_(read_varint_()));
+        previous_.y = static_cast<int>(previous_.y + unzigzag_(read_varint_()));
+        --remaining_;
+        return previous_;
+    }
+
+    // Estimate of performance: Linear in max.
+    // Short rationale for estimate: Decodes at most max coordinates to out with next()
+    // and returns how many were decoded (less than max only at the end of the shape).
+    std::size_t next(Coord* out, std::size_t max);
+
+private:
+    std::uint64_t read_varint_()
+    {
+        std::uint64_t value = 0;
+        for (int shift = 0; ; shift += 7)
+        {
+            std::uint8_t byte = *position_++;
+            value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0)
+            {
+                return value;
+            }
+        }
+    }
+
+    static long long unzigzag_(std::uint64_t value)
+    {
+        return static_cast<long long>(value >> 1) ^ -static_cast<long long>(value & 1);
+    }
+
+    std::uint8_t const* position_ = nullptr;
+    std::size_t remaining_ = 0;
+    Coord previous_ = {0,0};
+};
+
+// Forward iterator over the coordinates of a PackedShape. The current coordinate is
+// kept in the iterator, so references to it are valid until the iterator is advanced.
+class PackedShape::const_iterator
+{
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = Coord;
+    using difference_type = std::ptrdiff_t;
+    using pointer = Coord const*;
+    using reference = Coord const&;
+
+    const_iterator() = default;
+    const_iterator(ShapeDecoder decoder, std::size_t index) : decoder_(decoder), index_(index)
+    {
+        if (!decoder_.done())
+        {
+            current_ = decoder_.next();
+        }
+    }
+
+    reference operator*() const { return current_; }
+    pointer operator->() const { return &current_; }
+    const_iterator& operator++()
+    {
+        ++index_;
+        if (!decoder_.done())
+        {
+            current_ = decoder_.next();
+        }
+        return *this;
+    }
+    const_iterator operator++(int) { const_iterator old = *this; ++*this; return old; }
+    bool operator==(const_iterator const& other) const { return index_ == other.index_; }
+    bool operator!=(const_iterator const& other) const { return index_ != other.index_; }
+
+private:
+    ShapeDecoder decoder_;
+    Coord current_ = {0,0};
+    std::size_t index_ = 0;
+};
+
+inline PackedShape::const_iterator PackedShape::begin() const { return const_iterator(ShapeDecoder(*this),0); }
+inline PackedShape::const_iterator PackedShape::end() const { return const_iterator(ShapeDecoder(),size_); }
+inline Coord PackedShape::front() const { return *begin(); }
+
+// Handle of a name interned in a NamePool
+using NameHandle = std::uint32_t;
+NameHandle const NO_NAME_HANDLE = std::numeric_limits<NameHandle>::max();
+
+// Estimate of performance: O(|a|*|b|), or O(|a|*limit) if limit is given.
+// Short rationale for estimate: Levenshtein distance (insertions, deletions and
+// substitutions) with dynamic programming, two rows of the table are kept at a time.
+// With a limit only the cells at most limit away from the diagonal are computed, and
+// limit+1 is returned as soon as the distance is known to be greater than limit.
+// Letters are compared case-insensitively.
+std::size_t edit_distance(std::string_view a, std::string_view b,
+                          std::size_t limit = std::numeric_limits<std::size_t>::max());
+
+// Inverted index from trigrams (three consecutive characters, compared
+// case-insensitively) to the handles of the names containing them. Used to find
+// candidates for fuzzy name search without comparing the query to every name.
+// Names are padded with a '\0' character at both ends, so that the beginnings and
+// ends of names (and names of one or two characters) have trigrams too.
+class TrigramIndex
+{
+public:
+    // Estimate of performance: Average: O(l log l + l log p), in which l is the length of the
+    // name and p the length of the lists. O(l*p) if the handle is reused.
+    // Short rationale for estimate: The distinct trigrams of the name are sorted, and the handle
+    // is inserted to the sorted list of each trigram. A new handle is the largest one, so it is
+    // added to the end (amortized constant), a reused handle may have to move the list.
+    void insert(NameHandle handle, std::string_view name);
+
+    // Estimate of performance: Average: O(l*p), in which p is the length of the lists.
+    // Short rationale for estimate: The handle is binary searched from the list of every
+    // trigram of the name, and erasing it moves the rest of the list.
+    void erase(NameHandle handle, std::string_view name);
+
+    // Estimate of performance: Linear.
+    // Short rationale for estimate: .clear() for HashMap is linear.
+    void clear();
+
+    // Estimate of performance: Average: O(l log l + S*l + S*m*log p), in which S is the total
+    // length of the shortest l-min_shared+1 lists, m = min_shared and p the length of the others.
+    // Short rationale for estimate: Returns the handles of the names that have at least
+    // min_shared (>= 1) of the distinct trigrams of query. Such a name has to be in at least
+    // one of any t-min_shared+1 lists of the t trigrams of query, so only the shortest
+    // t-min_shared+1 lists are merged (the lists are sorted by handle) to get the names, and
+    // the other lists are binary searched only for those names. Long lists of very common
+    // trigrams are therefore not read through.
+    std::vector<NameHandle> candidates(std::string_view query, std::size_t min_shared) const;
+
+    // Estimate of performance: O(l log l).
+    // Short rationale for estimate: The trigrams of the padded name are sorted and
+    // duplicates are removed.
+    static std::vector<std::uint32_t> trigrams(std::string_view name);
+
+private:
+    HashMap<std::uint32_t,std::vector<NameHandle>,IdHash> handles_by_trigram_;
+};
+
+// Interning pool for names: every distinct name is stored only once and referred to
+// with a 32-bit handle, so places and areas with the same name share one string and
+// names can be compared by their handles. Handles are reference counted, and the
+// handle of a name that is no longer used is given to the next new name.
+// The characters of the names are stored in a MonotonicArena, so the memory of
+// names that are no longer used is released only by clear(). The names in use are
+// also kept in a TrigramIndex for fuzzy search.
+class NamePool
+{
+public:
+    // Estimate of performance: Average: O(l), in which l is the length of the name.
+    // Short rationale for estimate: The name is hashed and searched with .find()
+    // for HashMap. A new name is copied to the pool once.
+    // Adds one reference to the handle, which has to be released with release().
+    // If defer_trigrams is true, a new name is added to the trigram index only
+    // by the next index_deferred_trigrams().
+    NameHandle intern(Name const& name, bool defer_trigrams = false);
+
+    // Estimate of performance: O(m*l), in which m is the amount of names interned
+    // with defer_trigrams since the previous call and l their length.
+    // Short rationale for estimate: Each deferred name is inserted to the trigram index.
+    // Names released before this are skipped.
+    void index_deferred_trigrams();
+
+    // Estimate of performance: Constant on average.
+    // Short rationale for estimate: The reference count is decremented, and the
+    // name is removed from handles_ only when the last reference is released.
+    void release(NameHandle handle);
+
+    // Estimate of performance: Average: O(l), in which l is the length of the name.
+    // Short rationale for estimate: .find() for HashMap. Returns NO_NAME_HANDLE
+    // if no place or area has the name.
+    NameHandle find(Name const& name) const;
+
+    // Estimate of performance: Constant.
+    // Short rationale for estimate: Indexing a vector.
+    std::string_view name(NameHandle handle) const;
+
+    // Estimate of performance: Constant.
+    // Short rationale for estimate: size() for vector. Handles are smaller than this.
+    std::size_t handle_count() const;
+
+    // Estimate of performance: Constant.
+    // Short rationale for estimate: Returns a reference.
+    TrigramIndex const& trigrams() const;
+
+    // Estimate of performance: Linear.
+    // Short rationale for estimate: .clear() for the vectors and HashMap is linear.
+    void clear();
+
+private:
+    MonotonicArena arena_;
+    std::vector<std::string_view> names_; // views to arena_
+    std::vector<std::uint32_t> reference_counts_;
+    std::vector<NameHandle> free_handles_;
+    HashMap<std::string_view,NameHandle> handles_;
+    TrigramIndex trigrams_; // of the names in use
+    std::vector<NameHandle> deferred_trigrams_; // names not yet in trigrams_
+};
+
+// Orders (name handle, PlaceID) pairs by the names in a NamePool, and by the ID
+// if the names are the same. The pairs can also be compared to plain names, so that
+// a set ordered by this can be searched with a name (or a prefix of names).
+struct AlphabeticalOrder
+{
+    using is_transparent = void;
+
+    NamePool const* pool = nullptr;
+
+    bool operator()(std::pair<NameHandle,PlaceID> const& a, std::string_view b) const
+    {
+        return pool->name(a.first) < b;
+    }
+
+    bool operator()(std::string_view a, std::pair<NameHandle,PlaceID> const& b) const
+    {
+        return a < pool->name(b.first);
+    }
+
+    bool operator()(std::pair<NameHandle,PlaceID> const& a, std::pair<NameHandle,PlaceID> const& b) const
+    {
+        if (a.first == b.first)
+        {
+            return a.second < b.second; // same name, no need to compare strings
+        }
+        int order = pool->name(a.first).compare(pool->name(b.first));
+        return order < 0 || (order == 0 && a.second < b.second);
+    }
+};
+
+enum Status {WHITE, GRAY, BLACK};
+
 struct Area
 {
-    Name areaName;
-    std::vector<Coord> shape;
+    NameHandle areaName;
+    PackedShape shape; // stored in Datastructures::areas_arena_
+    // Computed from the shape when the area is added (see Datastructures::measure_shape_).
+    Coord boxMin;
+    Coord boxMax;
+    long long doubledSignedSize; // positive if the shape is counterclockwise, exact while coordinates are below 2^29
+    Coord centroid;
     bool isSubArea;
     AreaID parentAreaID;
     std::vector<AreaID> childrenAreas;
@@ -103,23 +918,491 @@ struct Node
 {
     Coord location;
     std::unordered_multimap<Coord,WayID,CoordHash> accesses;
-    Status node_status;
-    Distance steps_taken;
-    Distance route_distance_so_far;
-    Distance route_distance_estimate;
-    Node* previous_node;
-    Node* secondary_previous_node; // this is only used when finding cycles
-    WayID previous_way;
-    WayID secondary_previous_way; // this is only used when finding cycles
 };
 
 
 struct Way
 {
-    std::vector<Coord> coordinates;
+    Span<Coord const> coordinates; // stored in Datastructures::ways_arena_
     Distance distance;
 };
 
+// Read-only views of one place, area or way. The name and the coordinates are not
+// copied, they refer to the storage of Datastructures and stay valid until the element
+// is changed or removed (or the data is cleared). The coordinates of an area are
+// decoded while the shape is iterated (see PackedShape).
+struct PlaceView
+{
+    PlaceID id;
+    std::string_view name;
+    PlaceType type;
+    Coord coord;
+};
+
+struct AreaView
+{
+    AreaID id;
+    std::string_view name;
+    PackedShape shape;
+};
+
+struct WayView
+{
+    std::string_view id; // WayIDs are strings, so the ID is not copied either
+    Span<Coord const> coordinates;
+    Distance distance;
+};
+
+// Estimate of performance: Linear in count.
+// Short rationale for estimate: Computes the exact squared distances from xy to
+// coords[0..count) into out. Four (AVX2) or two (SSE4.1) coordinates are handled at
+// a time when the compiler targets those instruction sets (see prg2.pro), otherwise
+// a scalar loop is used. The vectorized versions subtract coordinates with 32-bit
+// integers, so coordinates should stay within +-2^30.
+void squared_distances(Coord const* coords, std::size_t count, Coord xy, long long* out);
+
+// Estimate of performance: Linear in count.
+// Short rationale for estimate: Computes the cross products x[i]*y[i+1]-x[i+1]*y[i] of
+// the consecutive coordinates coords[0..count) into out[0..count-1), which are the terms
+// of the shoelace formula. Vectorized the same way as squared_distances.
+void cross_products(Coord const* coords, std::size_t count, long long* out);
+
+// Estimate of performance: Linear in count.
+// Short rationale for estimate: Crossing number test: counts the edges of the polygon
+// shape[0..count) (the last coordinate is connected back to the first) that a ray from xy
+// to the right crosses, with exact integer arithmetic. Four edges are handled at a time
+// when the compiler targets AVX2 (see prg2.pro), otherwise a scalar loop is used.
+// Points on the boundary count as inside: the test alone leaves some of them outside, so
+// a point it leaves outside is checked against every edge once more.
+// Coordinates should stay within +-2^30, like in squared_distances.
+bool point_in_polygon(Coord const* shape, std::size_t count, Coord xy);
+
+// Estimate of performance: Linear in shape.size().
+// Short rationale for estimate: Same as above, but the coordinates are decoded with
+// ShapeDecoder in blocks of a few dozen, which are then tested like above.
+bool point_in_polygon(PackedShape const& shape, Coord xy);
+
+// Estimate of performance: O(n*m), in which n and m are the amounts of coordinates in
+// outer and inner.
+// Short rationale for estimate: Every coordinate of inner is tested with point_in_polygon,
+// which counts the boundary of outer as inside, so that shapes sharing a border are still
+// nested. Stops at the first coordinate outside. The edges of the shapes
+// are not tested against each other, so an inner shape cutting through a concave part of
+// outer counts as inside if all its coordinates are.
+bool polygon_in_polygon(Coord const* outer, std::size_t outer_count, Coord const* inner, std::size_t inner_count);
+
+// Uniform grid over place coordinates. After each rebuild the places are
+// packed cell by cell (row by row) into two parallel arrays (coordinates and IDs),
+// so the places of neighbouring cells are next to each other in memory. Places that are
+// added or moved to another cell after the rebuild are kept in a small
+// overflow map until the next rebuild. The cell size is chosen so that
+// there are only a couple of places per cell on average.
+// Datastructures keeps one grid for every PlaceType and one for all places.
+class PlaceGrid
+{
+public:
+    // Estimate of performance: Amortized constant on average.
+    // Short rationale for estimate: The place is pushed to one overflow cell,
+    // which is found with .find() for unordered_map. The grid is rebuilt in linear
+    // time only after the amount of places has doubled or halved, or the overflow
+    // has grown as large as the packed places, so rebuilding is amortized constant.
+    void insert(PlaceID id, Coord xy);
+
+    // Estimate of performance: Amortized constant on average.
+    // Short rationale for estimate: The place is searched from its cell only,
+    // and cells are expected to hold only a couple of places. Packed places
+    // are just marked removed. Rebuilding is amortized the same way as in insert.
+    void erase(PlaceID id, Coord xy);
+
+    // Estimate of performance: Amortized constant on average.
+    // Short rationale for estimate: If the new coordinate is in the same cell,
+    // the coordinate is updated in place, otherwise the place is erased and inserted.
+    void move(PlaceID id, Coord oldxy, Coord newxy);
+
+    // Estimate of performance: Linear in the amount of places and cells.
+    // Short rationale for estimate: The given places are added to the places already
+    // in the grid and the grid is rebuilt once, instead of inserting them one by one.
+    void insert_all(std::vector<PlaceID> const& ids, std::vector<Coord> const& coords);
+
+    // Estimate of performance: Linear in the amount of places and cells.
+    // Short rationale for estimate: .clear() for vectors and unordered_map is linear.
+    void clear();
+
+    // Estimate of performance: O(k*log(k) + c + p), in which c is the amount of cells visited
+    // and p the amount of places in them.
+    // Short rationale for estimate: Cells are visited in rings around the cell of xy
+    // (best-first), and the search is stopped as soon as no unvisited cell
+    // can contain a place closer than the k:th best found so far. With a couple
+    // of places per cell c and p are small and do not depend on the total amount of places.
+    // Places are ordered by their distance from xy and by y-coordinate if distances are equal.
+    // If there have been many changes since the latest rebuild, the grid is rebuilt
+    // first, which is amortized constant over those changes.
+    std::vector<PlaceID> nearest(Coord xy, std::size_t k);
+
+    // Estimate of performance: O(c + p + m*log(m)), in which c is the amount of cells
+    // overlapping the circle, p the amount of places in them and m the amount of places found.
+    // Short rationale for estimate: Only the cells overlapping the bounding square of the
+    // circle are visited, and the places found are sorted like in nearest().
+    // If the square would cover more cells than the grid has, all places are checked instead.
+    std::vector<PlaceID> within_radius(Coord xy, long long radius);
+
+    // Estimate of performance: O(c + p), in which c is the amount of cells overlapping
+    // the rectangle and p the amount of places in them.
+    // Short rationale for estimate: Only the cells overlapping the rectangle are visited.
+    // If the rectangle would cover more cells than the grid has, all places are checked instead.
+    // The places are returned in no particular order.
+    std::vector<PlaceID> in_rect(Coord min, Coord max);
+
+    // Estimate of performance: O(c + p*s), in which s is the amount of coordinates
+    // in the shape, c the amount of cells overlapping its bounding box (min, max) and p
+    // the amount of places in them.
+    // Short rationale for estimate: Only the cells overlapping the bounding box of the
+    // shape are visited like in in_rect, and the places inside the box are checked with
+    // point_in_polygon, so the places on the border of the shape are included. The places
+    // are returned in no particular order.
+    std::vector<PlaceID> in_polygon(Coord const* shape, std::size_t count, Coord min, Coord max);
+
+private:
+    struct Cell
+    {
+        std::vector<PlaceID> ids;
+        std::vector<Coord> coords;
+    };
+
+    // (squared distance, y, id), ordered so that the closest place is the smallest.
+    using Candidate = std::tuple<long long,int,PlaceID>;
+
+    std::uint64_t cell_key_(long long cx, long long cy) const;
+    bool is_packed_cell_(long long cx, long long cy) const;
+    std::size_t packed_index_(long long cx, long long cy) const;
+    void visit_block_(long long lo_x, long long hi_x, long long lo_y, long long hi_y,
+                      Coord xy, std::size_t k, std::vector<Candidate> & best) const;
+    void visit_cell_(long long cx, long long cy, Coord xy, std::size_t k, std::vector<Candidate> & best) const;
+    void visit_places_(PlaceID const* ids, Coord const* coords, std::size_t count,
+                       Coord xy, std::size_t k, std::vector<Candidate> & best) const;
+    template <typename Func>
+    void for_each_in_cells_(long long lo_x, long long hi_x, long long lo_y, long long hi_y, Func func) const;
+    void include_cell_(long long cx, long long cy);
+    void compact_if_needed_();
+    void collect_(std::vector<PlaceID> & ids, std::vector<Coord> & coords) const;
+    void build_(std::vector<PlaceID> const& ids, std::vector<Coord> const& coords);
+    void rebuild_();
+
+    int shift_ = 4;                 // cells are (1 << shift_) units wide
+    // Packed cells: places of packed cell i are at [cell_start_[i], cell_start_[i+1]) of the arrays.
+    long long packed_min_cx_ = 0, packed_min_cy_ = 0, packed_width_ = 0, packed_height_ = 0;
+    std::vector<std::uint32_t> cell_start_;
+    std::vector<Coord> coords_;
+    std::vector<PlaceID> ids_;      // NO_PLACE marks a removed place
+    std::vector<bool> has_overflow_; // for each packed cell, may it have places in overflow_
+    // Places added to the grid after the latest rebuild.
+    std::unordered_map<std::uint64_t,Cell> overflow_;
+    std::size_t overflow_size_ = 0;
+    std::size_t removed_ = 0;       // removed places still in the packed arrays
+    std::size_t size_ = 0;
+    std::size_t built_size_ = 0;    // amount of places in the latest rebuild
+    long long min_cx_ = 0, max_cx_ = -1, min_cy_ = 0, max_cy_ = -1; // cell range that may contain places
+};
+
+// Places stored as a structure of arrays: the place in slot i has its attributes
+// at index i of every array, so a scan over one attribute reads memory sequentially
+// instead of following pointers to hash table nodes. Slots are kept dense by
+// moving the last place to the slot of a removed one.
+class PlaceStore
+{
+public:
+    static constexpr std::size_t NO_SLOT = std::numeric_limits<std::size_t>::max();
+
+    std::vector<PlaceID> ids;
+    std::vector<int> xs;
+    std::vector<int> ys;
+    std::vector<PlaceType> types;
+    std::vector<NameHandle> names;
+    std::vector<std::size_t> type_bucket_indexes; // position of the place's ID in its type bucket
+
+    // Estimate of performance: Constant.
+    // Short rationale for estimate: size() for vector is constant.
+    std::size_t size() const;
+
+    // Estimate of performance: Average: Constant, Theta(1). Worst-case: O(n).
+    // Short rationale for estimate: .find() for HashMap.
+    // Returns NO_SLOT if there is no place with the given ID.
+    std::size_t find(PlaceID id) const;
+
+    // Estimate of performance: Amortized constant on average.
+    // Short rationale for estimate: .push_back() for the arrays is amortized
+    // constant and .insert() for HashMap constant on average.
+    // Returns NO_SLOT if a place with the given ID already exists.
+    std::size_t add(PlaceID id, NameHandle name, PlaceType type, Coord xy);
+
+    // Estimate of performance: Linear.
+    // Short rationale for estimate: .reserve() for the arrays and HashMap,
+    // so that adding up to count places in total does not reallocate them.
+    void reserve(std::size_t count);
+
+    // Estimate of performance: Constant on average.
+    // Short rationale for estimate: The last place is moved to the removed slot
+    // (swap-remove), so only its entry of slots_ needs to be updated.
+    void remove(std::size_t slot);
+
+    // Estimate of performance: Linear.
+    // Short rationale for estimate: .clear() for vectors and HashMap is linear.
+    void clear();
+
+    // Estimate of performance: Constant.
+    // Short rationale for estimate: Reads one element of xs and ys.
+    Coord coord(std::size_t slot) const;
+
+    // Estimate of performance: Constant.
+    // Short rationale for estimate: Writes one element of xs and ys.
+    void set_coord(std::size_t slot, Coord xy);
+
+private:
+    HashMap<PlaceID,std::size_t,IdHash> slots_; // ID -> slot
+};
+
+// The way graph frozen to compressed sparse row form for the route searches. The
+// crossroads are numbered in the iteration order of the nodes they are built from, and
+// the ways leaving crossroad i are the edges [edge_start[i], edge_start[i+1]) in the
+// iteration order of its accesses, so a search visits them in the same order as it
+// would visit the nodes. Ways are referred to by their index in the sorted way_ids.
+class WayGraph
+{
+public:
+    static constexpr std::uint32_t NO_NODE = std::numeric_limits<std::uint32_t>::max();
+    static constexpr std::uint32_t NO_EDGE = std::numeric_limits<std::uint32_t>::max();
+
+    std::vector<Coord> coords;              // of each crossroad
+    std::vector<std::uint32_t> edge_start;  // node_count()+1 offsets to the edge arrays
+    std::vector<std::uint32_t> edge_to;
+    std::vector<std::uint32_t> edge_way;    // index to way_ids
+    std::vector<Distance> edge_distance;
+    std::vector<WayID> way_ids;             // sorted
+
+    // Estimate of performance: O(V log V + W log W + E log W), in which V is the amount of
+    // crossroads, W the amount of ways and E the amount of accesses.
+    // Short rationale for estimate: The nodes and accesses are copied to the arrays once,
+    // the coordinates and way IDs are sorted for lookups, and the way of every edge is
+    // searched from the sorted way IDs.
+    void build(HashMap<Coord,Node,CoordHash> const& nodes, HashMap<WayID,Way> const& ways);
+
+    // Estimate of performance: Linear.
+    // Short rationale for estimate: .clear() for vectors is linear.
+    void clear();
+
+    // Estimate of performance: Constant.
+    // Short rationale for estimate: size() for vector.
+    std::size_t node_count() const;
+
+    // Estimate of performance: O(log V).
+    // Short rationale for estimate: Binary search from the sorted coordinates.
+    // Returns NO_NODE if there is no crossroad at xy.
+    std::uint32_t find(Coord xy) const;
+
+private:
+    std::vector<std::pair<Coord,std::uint32_t>> sorted_coords_; // (coordinate, node)
+};
+
+// The area hierarchy as a link-cut tree, so that areas can be added, moved and removed
+// without building the hierarchy again. Every tree of the forest is split into paths of
+// areas, and each path is kept in a splay tree ordered from the top area down. The parent
+// of the root of a splay tree is the area above the top of its path (path-parent). access_
+// makes the path from the root of the tree down to an area one splay tree, and the splay
+// trees keep that amortized O(log n). Every splay node also counts the nodes of its splay
+// subtree and the areas hanging below them by path-parents, so the depth and the amount of
+// subareas of an area are known after one access_.
+// Next to the splay trees the forest keeps the plain tree in dense arrays (parent, and the
+// subareas as a linked list in the order they were added), which link and cut update in
+// constant time. The upper areas and subareas of an area are walked from these arrays
+// without looking up areas_. Areas are found by their ID from a hash index, and the
+// indexes of removed areas are reused.
+class AreaForest
+{
+public:
+    static constexpr std::uint32_t NO_INDEX = std::numeric_limits<std::uint32_t>::max();
+
+    // Estimate of performance: O(n log n) amortized.
+    // Short rationale for estimate: Every area is added, in preorder so that the hierarchy
+    // is walked from nearby indexes, and the subareas of every area are linked to it in their
+    // order (see link), after checking with root_of that the link does not close a cycle.
+    // Returns false if the subareas make a cycle, in which case the links closing it are
+    // left out.
+    bool build(HashMap<AreaID,Area,IdHash> const& areas);
+
+    // Estimate of performance: Linear.
+    // Short rationale for estimate: .clear() for vectors and HashMap is linear.
+    void clear();
+
+    // Estimate of performance: Average: Constant, Theta(1). Worst-case: O(n)
+    // Short rationale for estimate: .find() for HashMap. Returns NO_INDEX if there is
+    // no area with the ID.
+    std::uint32_t find(AreaID id) const;
+
+    // Estimate of performance: Constant.
+    // Short rationale for estimate: Indexing a vector.
+    AreaID id(std::uint32_t index) const { return ids_[index]; }
+
+    // Estimate of performance: Constant.
+    // Short rationale for estimate: Indexing a vector. Returns NO_INDEX for a top-level area.
+    std::uint32_t parent(std::uint32_t index) const { return links_[index].parent; }
+
+    // Estimate of performance: Average: Constant, Theta(1). Worst-case: O(n)
+    // Short rationale for estimate: .insert() for HashMap, and the index of a removed area
+    // is reused or a node is pushed to nodes_. The area is added as a root with no subareas.
+    std::uint32_t add(AreaID id);
+
+    // Estimate of performance: O(log n) amortized.
+    // Short rationale for estimate: The area is cut from its parent (see cut), and its index
+    // is freed. The subareas of the area must have been cut or linked elsewhere before.
+    void remove(std::uint32_t index);
+
+    // Estimate of performance: O(log n) amortized.
+    // Short rationale for estimate: After access_ to both, child is alone in its splay tree
+    // and parent_index is the root of its own, so child just gets parent_index as its
+    // path-parent and is added to the counts of parent_index. child is added last to the
+    // subareas of parent_index in links_. child must be the root of its tree, and
+    // parent_index must not be in the subtree of child.
+    void link(std::uint32_t child, std::uint32_t parent_index);
+
+    // Estimate of performance: O(log n) amortized.
+    // Short rationale for estimate: After access_ the upper areas of child are the left
+    // subtree of its splay node, which is detached, and child is unlinked from the list of
+    // subareas of its parent. Does nothing if child is a root.
+    void cut(std::uint32_t child);
+
+    // Estimate of performance: O(log n) amortized.
+    // Short rationale for estimate: After access_ the root of the tree is the leftmost node
+    // of the splay tree of index, which is splayed to keep the amortized bound.
+    std::uint32_t root_of(std::uint32_t index);
+
+    // Estimate of performance: O(log n) amortized.
+    // Short rationale for estimate: One root_of call for each area, then access_ to
+    // index1 and index2. The second access_ joins the path of index1 at the common area.
+    // Returns the lowest area that is index1 or index2 or contains both, or NO_INDEX if
+    // they are in different trees.
+    std::uint32_t common_ancestor(std::uint32_t index1, std::uint32_t index2);
+
+    // Estimate of performance: O(log n) amortized.
+    // Short rationale for estimate: outer contains inner if it is their common ancestor
+    // (see common_ancestor). An area does not contain itself.
+    bool contains(std::uint32_t outer, std::uint32_t inner);
+
+    // Estimate of performance: O(log n + d) amortized, in which d is the amount of upper areas.
+    // Short rationale for estimate: After access_ the depth of index is the node count of the
+    // left subtree of its splay node, so result is resized once and filled by following
+    // the parent indexes of links_, nearest first.
+    void upper_areas(std::uint32_t index, std::vector<AreaID> & result);
+
+    // Estimate of performance: O(log n + k) amortized, in which k is the amount of subareas.
+    // Short rationale for estimate: After access_ the subareas of index are exactly the
+    // areas hanging below it by path-parents, whose count is kept in its node, so result is
+    // resized once. It is then filled in preorder by following the child and sibling indexes
+    // of links_, which needs no stack.
+    void subareas(std::uint32_t index, std::vector<AreaID> & result);
+
+private:
+    struct Node
+    {
+        std::uint32_t left;
+        std::uint32_t right;
+        std::uint32_t parent;        // in the splay tree, or the path-parent for the root of one
+        std::uint32_t path_count;    // nodes in this splay subtree
+        std::uint32_t size;          // areas in this splay subtree and below them
+        std::uint32_t virtual_size;  // areas below this node by path-parents
+    };
+
+    struct Links
+    {
+        std::uint32_t parent;
+        std::uint32_t first_child;
+        std::uint32_t last_child;
+        std::uint32_t previous_sibling;
+        std::uint32_t next_sibling;
+    };
+
+    bool is_splay_root_(std::uint32_t index) const;
+    // Recomputes path_count and size of index from its splay children.
+    void update_(std::uint32_t index);
+    void rotate_(std::uint32_t index);
+    void splay_(std::uint32_t index);
+    // Returns the last area where the path from the root joined a preferred path.
+    std::uint32_t access_(std::uint32_t index);
+
+    std::vector<Node> nodes_;
+    std::vector<Links> links_;
+    std::vector<AreaID> ids_;
+    std::vector<std::uint32_t> free_indexes_;
+    HashMap<AreaID,std::uint32_t,IdHash> index_of_;
+};
+
+// Static R-tree over the bounding boxes of the area shapes, bulk loaded with
+// Sort-Tile-Recursive packing: the boxes are sorted by x into vertical slices and
+// each slice by y, so that every NODE_SIZE consecutive boxes are close to each other.
+// The nodes are then packed the same way level by level up to one root. Children of
+// a node are next to each other in the arrays, and nodes are stored bottom-up.
+class AreaRTree
+{
+public:
+    // Estimate of performance: O(n log n).
+    // Short rationale for estimate: The bounding boxes and sizes are precomputed in the
+    // areas, and the boxes of every level are sorted twice (by x and within slices by y).
+    // The levels shrink by NODE_SIZE, so the first level dominates.
+    void build(HashMap<AreaID,Area,IdHash> const& areas);
+
+    // Estimate of performance: Linear.
+    // Short rationale for estimate: .clear() for vectors is linear.
+    void clear();
+
+    // Estimate of performance: O(log n + k*s) for boxes that overlap little, in which k
+    // is the amount of bounding boxes containing xy and s the amount of coordinates in
+    // their shapes. Worst-case O(n*s).
+    // Short rationale for estimate: Only the nodes whose box contains xy are visited, and
+    // the shapes of the leaves whose box contains xy are checked with point_in_polygon.
+    // (twice the size of the shape, ID) of every area containing xy is added to found.
+    void find(Coord xy, std::vector<std::pair<long long,AreaID>> & found) const;
+
+    // Estimate of performance: O(log n + k) for boxes that overlap little, in which k is
+    // the amount of bounding boxes containing the box (min, max). Worst-case O(n).
+    // Short rationale for estimate: Like find, but only the boxes are compared.
+    // (twice the size of the shape, ID) of every area whose bounding box contains the box
+    // is added to found.
+    void find_boxes_containing(Coord min, Coord max, std::vector<std::pair<long long,AreaID>> & found) const;
+
+private:
+    struct Box
+    {
+        Coord min;
+        Coord max;
+    };
+
+    // The shapes are read from Datastructures::areas_arena_, so the tree must be built
+    // again after the areas have been cleared.
+    struct Leaf
+    {
+        AreaID id;
+        PackedShape shape;
+        long long doubled_size;
+    };
+
+    struct Node
+    {
+        Box box;
+        std::uint32_t first; // children are at [first, first+count) of the level below
+        std::uint32_t count;
+    };
+
+    static constexpr std::size_t NODE_SIZE = 16;
+
+    static bool contains_(Box const& box, Coord xy);
+    static bool contains_(Box const& box, Coord min, Coord max);
+    static void str_order_(std::vector<Box> const& boxes, std::vector<std::uint32_t> & order);
+
+    std::vector<Box> leaf_boxes_;    // apart from the leaves, since most are only compared by box
+    std::vector<Leaf> leaves_;
+    std::vector<Node> nodes_;        // bottom-up, the root is the last node
+    std::size_t leaf_parents_ = 0;   // nodes [0, leaf_parents_) have leaves as children
+};
+
 // This is the class you are supposed to implement
 
 class Datastructures
@@ -129,106 +1412,165 @@ public:
     ~Datastructures();
 
     // Estimate of performance: Constant. Theta(1).
-    // Short rationale for estimate: unordered_map's member function size() is constant on complexity,
-    // which is being used here.
+    // Short rationale for estimate: PlaceStore keeps the places in dense arrays, and
+    // size() of the ID array is constant.
     int place_count();
 
-    // Estimate of performance: Linear. Theta(n)
-    // Short rationale for estimate:  unordered_map's member function clear()'s complexity
-    // is linear in the size of the container. Now clear() is being called for places_ and areas_
-    // but we can say that this operation's asymptotic efficiency is theta(n).
+    // Estimate of performance: Linear. Theta(n), in which n is the amount of places, areas,
+    // ways and names (and the capacities of the hash tables).
+    // Short rationale for estimate: Every container is cleared: the PlaceStore and the place
+    // indexes and grids, areas_ with the area forest and R-tree, the name pool and the ways
+    // (clear_ways). clear() of a HashMap goes through all its slots. The arenas of the names,
+    // area shapes and way coordinates release their blocks at once.
     void clear_all();
 
     // Estimate of performance: Linear. O(n).
-    // Short rationale for estimate: Processing data through for-loop cause it
-    // to be a linear operation. In the "best case", if the datastructure is empty, it may
-    // be a constant operation.
+    // Short rationale for estimate: The IDs of all places are kept in one
+    // continuous array of places_, which is copied to the result.
     std::vector<PlaceID> all_places();
 
-    // Estimate of performance: Average: Constant, Theta(1), worst-case: O(n).
-    // Short rationale for estimate: unordered_map.insert() is being used here,
-    // which is constant on average, but in worst-case O(n). Other opeartions used here are constant.
+    // Estimate of performance: O(log n).
+    // Short rationale for estimate: PlaceStore::add appends the place to the end of the
+    // arrays of places_ and inserts its slot to the ID lookup (.insert() for HashMap), which
+    // is amortized constant on average, but in worst-case O(n). The place is also inserted
+    // to places_in_alphabetical_order_ and places_in_coord_order_, and .insert() for set is O(log n).
     bool add_place(PlaceID id, Name const& name, PlaceType type, Coord xy);
 
+    // Estimate of performance: Average: O(k), in which k is the amount of places given.
+    // Short rationale for estimate: Like add_place for every place, but only places_ and
+    // name_pool_ are updated (amortized constant on average per place). The secondary
+    // indexes of the places (by name, type, alphabetical and coord order, PlaceGrids and
+    // trigrams) are built at once by creation_finished or by the first operation that
+    // needs them, which is O(n log n) but cheaper than inserting the places one by one.
+    // Places whose ID already exists (also earlier in the vector) are skipped.
+    // Returns the amount of places added.
+    std::size_t add_places_bulk(std::vector<std::tuple<PlaceID, Name, PlaceType, Coord>> const& places);
+
     // Estimate of performance: Average: Constant, Theta(1). Worst-case O(n).
-    // Short rationale for estimate: find() is being used here for unordered_map
-    // which's complexity is constant on average but may be O(n) in the worst case.
-    // at() is also used for unordered_map, which's complexity is similar than find()'s.
+    // Short rationale for estimate: The slot of the place is found with PlaceStore::find
+    // (.find() for HashMap), which is constant on average but may be O(n) in the worst case.
+    // The name handle and type are then read from that slot of the arrays in constant time.
     std::pair<Name, PlaceType> get_place_name_type(PlaceID id);
 
     // Estimate of performance: Average: Constant, Theta(1). Worst-Case O(n)
-    // Short rationale for estimate: find() is being used here for unordered_map
-    // which's complexity is constant on average but may be O(n) in the worst case.
-    // at() is also used for unordered_map, which's complexity is similar than find()'s.
+    // Short rationale for estimate: The slot of the place is found with PlaceStore::find
+    // (.find() for HashMap), which is constant on average but may be O(n) in the worst case.
+    // The coordinates are then read from that slot of xs and ys in constant time.
     Coord get_place_coord(PlaceID id);
 
-    // Estimate of performance: O(n*log(n))
-    // Short rationale for estimate: In the first for-loop
-    // we insert elements to map by using .insert(), which's complexity is O(log n). And
-    // we are doing that n times due to for-loop. On the second
-    // for-loop we add sorted placeIDs to vector using push_back(), which's
-    // complexity is constant O(1). Since the first for-loop (in which
-    // we insereted elements to map) is the most inefficient operation done here
-    // the asymptotic efficiency for this function is O(n*log(n)).
+    // Estimate of performance: O(n) after places have been added, removed or renamed,
+    // otherwise constant + copying of the result.
+    // Short rationale for estimate: places_in_alphabetical_order_ is a set
+    // that is kept in order by the operations that modify places, so the IDs only need
+    // to be read from it in order. The result is cached to alphabetical_order_cache_
+    // which is returned as such until the next modification.
     std::vector<PlaceID> places_alphabetically();
 
-    // Estimate of performance: O(n * log n)
-    // Short rationale for estimate: This function calls function
-    // get_closest_places_in_order, which is defined in the private
-    // interface of class datastructures, and its complexity is O(n*log n).
-    // This function includes also another for-loop which
-    // includes another for-loop. However, this double-for-loop structure's
-    // complexity is not actually O(n^2) though you might think so.
-    // The detailed explanaiton for this is written in function's definition
-    // in datastructures.cc.
+    // Estimate of performance: O(n) after places have been added, removed or moved,
+    // otherwise constant + copying of the result.
+    // Short rationale for estimate: places_in_coord_order_ is a set that is
+    // kept in order by the operations that modify places, so the IDs only need to
+    // be read from it in order. The result is cached to coord_order_cache_
+    // which is returned as such until the next modification.
     std::vector<PlaceID> places_coord_order();
 
-    // Estimate of performance: O(n)
-    // Short rationale for estimate: For-loop causes it to
-    // be a linear operation, push_back() doesn't affect to
-    // efficiency, since it is a constant operation. On most
-    // cases it is theta(n), but in the scenario where places_
-    // is empty, it is constant.
+    // Estimate of performance: Average: O(k), in which k is the amount of places with the given name.
+    // Worst-case: O(n).
+    // Short rationale for estimate: The IDs of places are kept grouped by their name handle
+    // in places_by_name_, so only the handle of the name is searched from name_pool_
+    // (constant on average) and after that only the matching IDs are copied to the vector
+    // that is returned.
     std::vector<PlaceID> find_places_name(Name const& name);
 
-    // Estimate of performance: O(n)
-    // Short rationale for estimate: For-loop causes it to
-    // be a linear operation, push_back() doesn't affect to
-    // efficiency, since it is a constant operation. On most
-    // cases it is theta(n), but in the scenario where places_
-    // is empty, it is constant.
+    // Estimate of performance: O(log n + k), in which k is the number of places returned.
+    // Short rationale for estimate: The first name that is not smaller than the prefix
+    // is searched from places_in_alphabetical_order_ with .lower_bound() for set (O(log n)
+    // name comparisons), and the places are then read in order until the name no longer
+    // starts with the prefix or limit places have been found. Returns the places in
+    // alphabetical order (same order as places_alphabetically).
+    std::vector<PlaceID> find_places_name_prefix(Name const& prefix, int limit);
+
+    // Estimate of performance: Average: O(P log P + c*l^2 + k log k), in which P is the length
+    // of the trigram lists read, c the number of candidate names and k the number of places found.
+    // Short rationale for estimate: Finds places whose name is at most e = max(1, l/4) edits
+    // (edit_distance) from the query of length l. Each edit changes at most 3 trigrams, so such a
+    // name shares at least t-3e of the t trigrams of the query, and the candidate names are taken
+    // from the trigram index of name_pool_ (names of places and areas) with that limit. Only the
+    // candidates are compared with edit_distance. Names sharing no trigram with the query are not
+    // found even if they are close enough (only possible for queries shorter than about 6).
+    // Returns at most max_results places ordered by the edit distance of their name, then by
+    // name and ID.
+    std::vector<PlaceID> find_places_fuzzy(Name const& query, int max_results);
+
+    // Estimate of performance: O(k), in which k is the amount of places of the given type.
+    // Short rationale for estimate: IDs of places are kept in one vector per
+    // PlaceType in places_by_type_, so the right vector is just copied. Copying
+    // a vector is linear in its size.
     std::vector<PlaceID> find_places_type(PlaceType type);
 
-    // Estimate of performance: Average: Constant, Theta(1). Worst-case:  O(n)
-    // Short rationale for estimate: This function uses uses .find() and
-    // .at() for unordered_map, which are both constant on average, but on
-    // worst-case they are linear.
+    // Estimate of performance: O(log n).
+    // Short rationale for estimate: The slot of the place is found with PlaceStore::find
+    // (.find() for HashMap), which is constant on average, but on worst-case
+    // linear, and its name handle is replaced in place. The place is also moved from one name group
+    // of places_by_name_ to another, which is done with similar operations, and
+    // its entry of places_in_alphabetical_order_ is replaced, which is O(log n).
     bool change_place_name(PlaceID id, Name const& newname);
 
-    // Estimate of performance: Average: Constant, Theta(1). Worst-case:  O(n)
-    // Short rationale for estimate: This function uses uses .find() and
-    // .at() for unordered_map, which are both constant on average, but on
-    // worst-case they are linear.
+    // Estimate of performance: O(log n).
+    // Short rationale for estimate: The slot of the place is found with PlaceStore::find
+    // (.find() for HashMap), which is constant on average, but on worst-case
+    // linear, and its coordinates are written in place. The entry of the place in places_in_coord_order_
+    // is replaced, and .erase() and .insert() for set are O(log n).
+    // The place is moved in its two PlaceGrids, which is constant on average.
     bool change_place_coord(PlaceID id, Coord newcoord);
 
-    // Estimate of performance: Average: constant, theta(1). Worst-case: O(n).
-    // Short rationale for estimate: insert() is being used here for
-    // unordered_map, which is constant on average but its worst_case is O(n).
-    // All other operations used here are constant.
+    // Estimate of performance: Average: O(s + l), in which s is the amount of coordinates
+    // and l the length of the name. Worst-case: O(n + s + l).
+    // Short rationale for estimate: The shape is encoded into the arena (PackedShape::encode)
+    // and its bounding box, size and centroid are computed (measure_shape_), which are both
+    // linear in s. The name is interned, which is O(l) on average. insert() for HashMap is
+    // constant on average but its worst_case is O(n), and so is adding the area to the
+    // area forest when the forest is up to date.
     bool add_area(AreaID id, Name const& name, std::vector<Coord> coords);
 
+    // Estimate of performance: Average: O(k), in which k is the amount of areas given.
+    // Short rationale for estimate: Like add_area for every area after reserving space
+    // for them in areas_. Adding the names to the trigram index is deferred like in
+    // add_places_bulk. Returns the amount of areas added.
+    std::size_t add_areas_bulk(std::vector<std::tuple<AreaID, Name, std::vector<Coord>>> const& areas);
+
     // Estimate of performance: Average: constant,  theta(1). Worst-case: O(n).
     // Short rationale for estimate: .at() and .find() are both averagely
     // constant and linear in worst case and only those operations are used
     // here.
     Name get_area_name(AreaID id);
 
-    // Estimate of performance: Average: constant,  theta(1). Worst-case: O(n).
+    // Estimate of performance: Average: O(s), in which s is the amount of coordinates
+    // in the shape. Worst-case: O(n + s).
     // Short rationale for estimate: .at() and .find() are both averagely
-    // constant and linear in worst case and only those operations are used
-    // here.
+    // constant and linear in worst case, and the shape is decoded to the
+    // vector in linear time (see PackedShape).
     std::vector<Coord> get_area_coords(AreaID id);
 
+    // Estimate of performance: Average: constant, theta(1). Worst-case: O(n).
+    // Short rationale for estimate: .find() for HashMap, the box is computed when the
+    // area is added. Returns the smallest rectangle containing the shape as
+    // (lower left, upper right) corner, or {NO_COORD, NO_COORD} if there is no such area.
+    std::pair<Coord,Coord> area_bbox(AreaID id);
+
+    // Estimate of performance: Average: constant, theta(1). Worst-case: O(n).
+    // Short rationale for estimate: .find() for HashMap, the size is computed when the
+    // area is added. Returns the size of the shape (regardless of the direction of the
+    // coordinates), or NO_AREA_SIZE if there is no such area.
+    AreaSize area_size(AreaID id);
+
+    // Estimate of performance: Average: constant, theta(1). Worst-case: O(n).
+    // Short rationale for estimate: .find() for HashMap, the centroid is computed when the
+    // area is added. Returns the centroid of the shape rounded to the nearest coordinate (or
+    // the average of the coordinates if the shape has no size), or NO_COORD if there is no
+    // such area.
+    Coord area_centroid(AreaID id);
+
     // Estimate of performance: Linear. O(n)
     // Short rationale for estimate: For-loop
     // causes it to be linear, since it loops always
@@ -238,61 +1580,183 @@ public:
     // is also being used here.
     std::vector<AreaID> all_areas();
 
-    // Estimate of performance: Average: Constant, Theta(1). Worst-case: O(n)
-    // Short rationale for estimate: .at() and .find() are
-    // used here for unordered_map and .insert() is being used for unordered_set.
-    // all of those operations are averagely constant on complexity, but their
-    // worst-case is O(n).
+    // Estimate of performance: O(log n) amortized.
+    // Short rationale for estimate: Both areas are found with .find() for HashMap
+    // (areas_), which is constant on average, the subarea is appended to the children
+    // of the parent, and the subarea is linked to its parent in area_forest_ (see AreaForest::link).
     bool add_subarea_to_area(AreaID id, AreaID parentid);
 
-    // Estimate of performance: O(n)
-    // Short rationale for estimate: This function
-    // calls recursive function get_upper_areas_, which
-    // is defined in the private interface of class datastructures.
-    // get_upper_areas_ adds all direct or indirect "parents"
-    // of an area given as parameter to a vector given as a parameter as well.
-    // In the worst case Area-tree has only one branch, hence the operation is linear,
-    // causing the asymptotic efficiency to be O(n).
+    // Estimate of performance: O(log n + d) amortized, in which d is the amount of upper areas
+    // returned. Worst-case O(n).
+    // Short rationale for estimate: The upper areas are read from area_forest_ (see
+    // get_upper_areas_): its depth sizes the result once, and the parents are followed from
+    // the dense arrays of the forest without looking up areas_. If the subareas form a
+    // cycle, the parents are followed from areas_ instead, and the walk stops after as many
+    // upper areas as there are areas.
     std::vector<AreaID> subarea_in_areas(AreaID id);
 
-    // Estimate of performance:
-    // Short rationale for estimate:
+    // Estimate of performance: O(log n) amortized.
+    // Short rationale for estimate: Two lookups from area_forest_, and parentid contains
+    // id if it is their common ancestor (see AreaForest::contains). area_forest_ is kept
+    // up to date as the areas change, and built only by the first area query. If the
+    // subareas form a cycle, the upper areas of id are walked instead in O(n).
+    // Returns true if id is a direct or indirect subarea of parentid.
+    bool is_subarea_of(AreaID id, AreaID parentid);
+
+    // Estimate of performance: O(log n + k*s + m log m), in which k is the amount of
+    // areas whose bounding box contains xy, s the amount of coordinates in their shapes
+    // and m the amount of areas returned.
+    // Short rationale for estimate: The areas whose bounding box contains xy are found from
+    // area_rtree_, and each of them is checked with point_in_polygon, so an area also
+    // contains the points on its border. The areas that contain xy are sorted by the size
+    // of their shape (and ID), so that the innermost area is first. If areas have been
+    // added after the previous query, area_rtree_ is first built again.
+    std::vector<AreaID> areas_containing(Coord xy);
+
+    // Estimate of performance: O(a*(s + c + p*s) + m log m), in which a is the amount of
+    // areas searched (1, or the area and its subareas if recursive), and s, c and p are as
+    // in PlaceGrid::in_polygon for each of them, and m is the amount of places found.
+    // Short rationale for estimate: The places inside the shape of every area searched are
+    // found from the grid of all places (see PlaceGrid::in_polygon). If recursive, the
+    // subareas are found with get_subareas_ and the places are sorted to remove duplicates.
+    // A place on the border of an area is in it, like in areas_containing. The places are
+    // returned in no particular order.
+    std::vector<PlaceID> places_in_area(AreaID id, bool recursive);
+
+    // Estimate of performance: O((a*(log n + k*s*t))/w + a*d), in which a is the amount of
+    // areas that are not subareas yet, k the amount of bounding boxes containing the box of
+    // such an area, s and t the amounts of coordinates in the shapes compared, w the amount
+    // of threads and d the depth of the area hierarchy.
+    // Short rationale for estimate: The areas whose bounding box contains the box of an area
+    // are found from area_rtree_ and tried from the smallest up with polygon_in_polygon
+    // (see smallest_enclosing_area_). The areas are split between the hardware threads,
+    // which only read areas_ and area_rtree_. The areas found are then added as parents one
+    // by one like in add_subarea_to_area, unless that would make a cycle with the existing
+    // subareas. Areas of the same size are nested by ID to avoid cycles between equal shapes.
+    // Returns the amount of subareas added.
+    std::size_t build_area_hierarchy();
+
+    // Estimate of performance: O(n log n).
+    // Short rationale for estimate: Builds the indexes deferred by add_places_bulk,
+    // add_areas_bulk and add_ways_bulk (see build_deferred_indexes_), and freezes the
+    // way graph to way_graph_ and the area shapes to area_rtree_, which the queries use
+    // until the ways or areas are changed. area_forest_ is built too if it is out of date.
+    // All of them are built in O(n log n).
     void creation_finished();
 
-    // Estimate of performance: Linear O(n).
-    // Short rationale for estimate: All operations
-    // used directly inside of this function are constants on average
-    // but this function calls recursive function get_subareas_ which is
-    // implemented in private interface of class datastructures. There,
-    // if the given area is the "root" area, all areas will be added to
-    // vector that this function will return. Therefore, the performance
-    // is O(n) since the "worst-case" is linear operation.
+    // Estimate of performance: O(log n + k) amortized, in which k is the amount of subareas
+    // returned. Worst-case O(n).
+    // Short rationale for estimate: The subareas are read from area_forest_ in preorder (see
+    // get_subareas_): their count sizes the result once, and each of them is visited once
+    // in the dense arrays of the forest. If the subareas form a cycle, they are walked from
+    // areas_ instead.
     std::vector<AreaID> all_subareas_in_area(AreaID id);
 
-    // Estimate of performance: O(n*log(n)).
-    // Short rationale for estimate: This operation calls function
-    // get_closest_places_in_order, which is defined in the private interface
-    // of class datastructures. get_closest_places_in_order's complexity is
-    // O(n*log(n)), and since the for-loop used inside this function is
-    // actually constant in time (read from datastructures.cc why so),
-    // the asymptotic efficiency for this function is O(n*log(n)) as well.
+    // Estimate of performance: Constant on average (O(c), in which c is the amount of grid cells visited).
+    // Short rationale for estimate: The places are searched from the PlaceGrid of the given
+    // type (or from the grid of all places). The grid search visits only the cells around xy
+    // until the three closest places are certainly found, and the amount of those cells
+    // does not grow with the amount of places.
     std::vector<PlaceID> places_closest_to(Coord xy, PlaceType type);
 
-    // Estimate of performance: Constant. Theta(1).
-    // Short rationale for estimate: .erase() is being
-    // used only here for unordered_map, which is linear in the
-    // number of elements removed, and we are only removing one element
-    // here, which makes this operation to be constant on time.
+    // Estimate of performance: Constant on average for small k (O(c + k*log(k)), in which c is
+    // the amount of grid cells visited).
+    // Short rationale for estimate: Like places_closest_to, but the k closest places are searched.
+    // The amount of cells visited grows with k but not with the amount of places.
+    std::vector<PlaceID> places_nearest(Coord xy, PlaceType type, int k);
+
+    // Estimate of performance: O(c + m*log(m)), in which c is the amount of grid cells
+    // overlapping the circle and m the amount of places found.
+    // Short rationale for estimate: Only the cells of the PlaceGrid of the given type
+    // that overlap the circle are visited. The places found are sorted by their distance from xy.
+    std::vector<PlaceID> places_within_radius(Coord xy, Distance radius, PlaceType type);
+
+    // Estimate of performance: O(c + m), in which c is the amount of grid cells
+    // overlapping the rectangle and m the amount of places found.
+    // Short rationale for estimate: Only the cells of the PlaceGrid of the given type
+    // that overlap the rectangle are visited. The places are returned in no particular order.
+    std::vector<PlaceID> places_in_rect(Coord min, Coord max, PlaceType type);
+
+    // Views for reading the data without copying it (used by the GUI and the print
+    // functions of the main program).
+
+    // Estimate of performance: Constant.
+    // Short rationale for estimate: The IDs of all places are already kept in
+    // one continuous array, the span refers to it. The span is invalidated by
+    // adding or removing places.
+    Span<PlaceID const> place_ids() const;
+
+    // Estimate of performance: Average: Constant, Theta(1). Worst-case: O(n).
+    // Short rationale for estimate: .find() for HashMap. For a missing place the
+    // view is {NO_PLACE, NO_NAME, NO_TYPE, NO_COORD}.
+    PlaceView place_view(PlaceID id) const;
+
+    // Estimate of performance: Average: Constant, Theta(1). Worst-case: O(n).
+    // Short rationale for estimate: .find() for HashMap. For a missing area the
+    // view is {NO_AREA, NO_NAME, empty shape}.
+    AreaView area_view(AreaID id) const;
+
+    // Estimate of performance: Average: Constant, Theta(1). Worst-case: O(n).
+    // Short rationale for estimate: .find() for HashMap. For a missing way the
+    // view is {NO_WAY, empty coordinates, NO_DISTANCE}.
+    WayView way_view(WayID id) const;
+
+    // Estimate of performance: Linear. Theta(n).
+    // Short rationale for estimate: Goes once through the arrays of places_ in
+    // slot order and calls visit(PlaceView const&) for every place.
+    // visit must not add, remove or change places.
+    template<typename Visitor>
+    void for_each_place(Visitor visit) const;
+
+    // Estimate of performance: Linear. Theta(n).
+    // Short rationale for estimate: Goes once through areas_ and calls
+    // visit(AreaView const&) for every area. visit must not change the areas.
+    template<typename Visitor>
+    void for_each_area(Visitor visit) const;
+
+    // Estimate of performance: Linear. Theta(n).
+    // Short rationale for estimate: Goes once through ways_ and calls
+    // visit(WayView const&) for every way. visit must not change the ways.
+    template<typename Visitor>
+    void for_each_way(Visitor visit) const;
+
+    // Estimate of performance: O(log n).
+    // Short rationale for estimate: The slot of the place is found with PlaceStore::find
+    // (.find() for HashMap), and the place is swap-removed from places_: the last place
+    // is moved to its slot and only the lookup entry of that place is updated, which is
+    // constant on average. The ID is erased from its name group of places_by_name_
+    // (.erase() for unordered_set, constant on average).
+    // The ID is swap-removed from its type bucket in constant time, and erased from
+    // places_in_alphabetical_order_ and places_in_coord_order_ in O(log n), which
+    // makes this operation O(log n).
     bool remove_place(PlaceID id);
 
-    // Estimate of performance: O(n^2).
-    // Short rationale for estimate: Double-for-loop inside this operation
-    // causes it to be O(n^2). This is for the worst case only, in which the nearest common ancestor
-    // is the root of the tree and the tree has only two branches. This function calls recursive function
-    // get_upper_areas, which is defined in private interface of class datastructures.
-    // get_upper_areas's complexity is O(n).
+    // Estimate of performance: O(log n) amortized.
+    // Short rationale for estimate: The nearest common area is the common ancestor of
+    // the parents of the areas in area_forest_ (see AreaForest::common_ancestor), which
+    // is kept up to date as the areas change. If the subareas form a cycle, the upper
+    // areas are compared with a double-for-loop in O(n^2).
     AreaID common_area_of_subareas(AreaID id1, AreaID id2);
 
+    // Estimate of performance: O((c+1) log n + s) amortized, in which c is the amount of
+    // direct subareas of the area and s the amount of subareas of its parent.
+    // Short rationale for estimate: The direct subareas are moved to the parent of the
+    // area (or become top-level areas if it has none) in areas_ and in area_forest_, where
+    // each move is a cut and a link. The area is erased from the subareas of its parent
+    // with a linear search, and from areas_ and area_rtree_, which is built again by the
+    // next areas_containing. The shape stays in areas_arena_ until clear_all.
+    // Returns false if there is no such area.
+    bool remove_area(AreaID id);
+
+    // Estimate of performance: O(log n + s) amortized, in which s is the amount of
+    // subareas of the old parent.
+    // Short rationale for estimate: is_subarea_of checks that parentid is not inside the
+    // area, then the area is erased from the subareas of its old parent with a linear
+    // search and added to parentid, and in area_forest_ it is cut and linked again with
+    // all its subareas. parentid NO_AREA makes the area a top-level area.
+    // Returns false if either area does not exist or the move would make a cycle.
+    bool move_subarea(AreaID id, AreaID parentid);
+
     // Phase 2 operations
 
     // Estimate of performance: Linear. O(n)
@@ -316,6 +1780,12 @@ public:
     // performance is O(n).
     bool add_way(WayID id, std::vector<Coord> coords);
 
+    // Estimate of performance: Average: O(k), in which k is the total amount of coordinates given.
+    // Short rationale for estimate: Like add_way for every way after reserving space for
+    // them in ways_, but the ways are connected to nodes_ only when creation_finished
+    // or the first operation that needs nodes_ is called. Returns the amount of ways added.
+    std::size_t add_ways_bulk(std::vector<std::pair<WayID, std::vector<Coord>>> const& ways);
+
     // Estimate of performance: O(n)
     // Short rationale for estimate: Usage of for-loop cause
     // this operation to be O(n) on complexity. Methods used here
@@ -329,19 +1799,18 @@ public:
     // more details.
     std::vector<std::pair<WayID, Coord>> ways_from(Coord xy);
 
-    // Estimate of performance: Constant on average. Linear in worst case.
-    // Short rationale for estimate: .at() and .find() for unordered_map
-    // are constant on average, linear on worst cases, .end() is constant for
-    // unordered_map, and no other method is being used here.
+    // Estimate of performance: Average: O(k), in which k is the amount of coordinates
+    // of the way. Worst-case O(n + k).
+    // Short rationale for estimate: The way is found with .find() for HashMap (ways_),
+    // which is constant on average but linear in the worst case, and its coordinates
+    // are copied from ways_arena_ to the vector that is returned.
     std::vector<Coord> get_way_coords(WayID id);
 
-    // Estimate of performance: Linear. O(n)
-    // Short rationale for estimate: ways_ is unordered_map,
-    // and its method .clear() is linear on size, which is
-    // being used here. Allthough, if ways have been already
-    // cleared earlier or there is no ways added at all
-    // this operation is constant in complexity because
-    // there is no a single element to be removed.
+    // Estimate of performance: Linear. O(n), in which n is the capacity of ways_ and nodes_.
+    // Short rationale for estimate: ways_ and nodes_ are HashMaps, whose .clear() goes
+    // through all their slots and keeps the capacity, so clearing is linear in the capacity
+    // even if there are no ways left. The coordinates of all ways are released from
+    // ways_arena_ at once, and the way graph is cleared.
     void clear_ways();
 
     // Estimate of performance: O(n).
@@ -358,10 +1827,10 @@ public:
     // Non-compulsory operations
 
     // Estimate of performance: Constant on average, linear on worst case.
-    // Short rationale for estimate: This method uses .find(), .end(), .at()
-    // and .erase() for unordered_map and .front() and .back() for vector,
-    // and all of these are either constants all the time or constants on average
-    // but linear in worst case.
+    // Short rationale for estimate: The way is found with .find() for HashMap (ways_), the
+    // nodes of its ends with .at() for HashMap (nodes_), and the way is erased from the
+    // accesses of both nodes (unordered_multimap) and from ways_. These are constant on
+    // average but linear in worst case.
     bool remove_way(WayID id);
 
     // Estimate of performance: O(n)
@@ -411,29 +1880,67 @@ public:
 
 private:
 
-    // Estimate of performance: Linear. O(n).
-    // Short rationale for estimate: This is a recursive function that loops through every
-    // subarea of an area (direct and indirect) in preorder and adds them to vector which is given as a
-    // reference as a parameter. Usage of for-loop inside of this operation causes this to be linear on
-    // complexity.
+    // Estimate of performance: O(log n + k) amortized, in which k is the amount of subareas
+    // added. Worst-case: O(n).
+    // Short rationale for estimate: The subareas (direct and indirect) of the area are added
+    // in preorder to the vector which is given as a reference as a parameter, from
+    // area_forest_ (see AreaForest::subareas), which is built first if it is out of date.
+    // If the subareas form a cycle, they are walked from areas_ with an explicit stack
+    // instead, and the walk stops after as many subareas as there are areas.
     void get_subareas_(AreaID id,std::vector<AreaID> & subareas_already_added);
 
-    // Estimate of performance: Constant. Theta(1). Worst-case: O(n). (In its actual recursive use, it is O(n),
-    // but one run of this function is constant on average).
-    // Short rationale for estimate: This is a recursive function that loops through every
-    // "parents" of an area (direct and indirect) in postorder and adds them to vector to which is given as a
-    // reference as a parameter. However, one run of this function is actually constant in time since
-    // this function is using only operations .find(), .end() and .at() for unordered_map and .push_back() for
-    // vector, which are all constants on average, but some of them may be linear in the worst case.
+    // Estimate of performance: O(log n + d) amortized, in which d is the amount of upper
+    // areas. Worst-case: O(n).
+    // Short rationale for estimate: The upper areas are added to the vector which is given as
+    // a reference as a parameter, nearest first, from area_forest_ (see
+    // AreaForest::upper_areas), which is built first if it is out of date. If the subareas
+    // form a cycle, the parents are followed from areas_ in a loop instead, and the loop
+    // stops after as many upper areas as there are areas.
     void get_upper_areas_(AreaID id1, std::vector<AreaID> & upper_areas);
 
-    // Estimate of performance: O(n * log n)
-    // Short rationale for estimate: This function sorts places based on their distance from location given
-    // as a parameter xy by inserting them into map in for-loop. (And only certain types of places, if paramerer type is
-    // something else than NO_PLACE.) Usage of insert() and find() for map
-    // inside the for loop is the most inefficient operation done here, and the complexity for both of
-    // those operations are logarithmic. The usage of those inside the for loop brings the coefficient n.
-    void get_places_in_order(Coord xy, PlaceType type, std::map<double,std::multimap<int,PlaceID>> & places_in_order);
+    // Estimate of performance: Amortized constant, Theta(1).
+    // Short rationale for estimate: The PlaceID is pushed to the end of
+    // the bucket of its type and the position is stored to the place's slot,
+    // .push_back() for vector is amortized constant.
+    void add_to_type_bucket_(std::size_t slot);
+
+    // Estimate of performance: Average: Constant, Theta(1). Worst-case: O(n).
+    // Short rationale for estimate: The place's ID is overwritten by the last ID
+    // of the bucket and .pop_back() is called, which are both constant. The
+    // position of the moved ID is updated to its slot found by .find() of
+    // PlaceStore, which is constant on average.
+    void remove_from_type_bucket_(std::size_t slot);
+
+    // Estimate of performance: Amortized constant on average.
+    // Short rationale for estimate: This adds the given PlaceID to the name group
+    // of places_by_name_ with .insert() for unordered_set, which is constant on average.
+    // places_by_name_ is grown to cover all handles of name_pool_ if needed.
+    void index_place_name_(PlaceID id, NameHandle name);
+
+    // Estimate of performance: Average: Constant, Theta(1). Worst-case: O(n).
+    // Short rationale for estimate: This removes the given PlaceID from the
+    // name group of places_by_name_ with .erase() for unordered_set, which is
+    // constant on average, and releases the name handle from name_pool_.
+    void unindex_place_name_(PlaceID id, NameHandle name);
+
+    // Estimate of performance: O(m log n + w), in which m is the amount of places and
+    // w the amount of ways added by the bulk operations since the previous call.
+    // Constant if nothing has been deferred.
+    // Short rationale for estimate: The deferred places are indexed by name and type
+    // (constant on average each), sorted and inserted to the ordered sets, and the
+    // PlaceGrids are rebuilt once. Inserting sorted places to an empty set with
+    // a hint is amortized constant, so building the sets from scratch is O(m log m)
+    // (the sort). Deferred ways are connected to nodes_ and deferred names are added
+    // to the trigram index. Called at the start of every operation that uses these
+    // indexes, so the deferral is not visible outside.
+    void build_deferred_indexes_();
+
+    // Estimate of performance: Constant on average.
+    // Short rationale for estimate: The nodes at both ends of the way are searched
+    // from nodes_ with .find() for HashMap and inserted to it if they are new, which
+    // is constant on average, and the way is inserted to their accesses (.insert()
+    // for unordered_multimap, constant on average).
+    void connect_way_(WayID const& id, Coord front, Coord back);
 
     // Estimate of performance: Linear. O(n)
     // Short rationale for estimate: This method calculates
@@ -446,25 +1953,61 @@ private:
     // this operation is constant.
     Distance calculate_distance(std::vector<Coord> const coords);
 
-    //
     // Estimate of performance: Constant
-    // Short rationale for estimate: This method simplifically
-    // calculates the distance between two coordinates.
+    // Short rationale for estimate: This method calculates a lower bound
+    // for the length of a route between two coordinates with integers.
+    // It is used as the heuristic of A*.
     Distance distance_between_nodes(Coord point1, Coord point2);
 
+    // Estimate of performance: Constant
+    // Short rationale for estimate: This method calculates the exact
+    // squared distance between two coordinates with 64-bit integers.
+    long long squared_distance(Coord point1, Coord point2);
+
+    // Estimate of performance: Constant
+    // Short rationale for estimate: Builds the key of places_in_coord_order_,
+    // which is (squared distance from origo, y-coordinate, PlaceID).
+    std::tuple<long long, int, PlaceID> coord_order_key_(PlaceID id, Coord xy);
+
     // Estimate of performance: O(n)
-    // Short rationale for estimate:
-    // If there are no nodes at all or there are only one,
-    // this operation is constant on complexity.
-    // the complexity of this operation grows linearly with
-    // the size of nodes_, because this operation loops through
-    // all the nodes inside a for-loop. .at() is used inside
-    // a for-loop for unordered_map here, but it is constant
-    // in all the cases, because the for-loop ensures
-    // that it is called only for those nodes that truly
-    // exist in nodes_.
+    // Short rationale for estimate: The search arrays (node_status_ etc.) are
+    // reset for every crossroad of way_graph_ with .assign() for vector, which
+    // is linear but only writes continuous memory.
     void restore_nodes();
 
+    // Estimate of performance: O(V log V + E log W) if ways have been changed after the
+    // previous call, otherwise constant.
+    // Short rationale for estimate: Builds way_graph_ from nodes_ again only if it is
+    // out of date (see WayGraph::build). Called by the route searches.
+    void freeze_way_graph_();
+
+    // Estimate of performance: O(n log n) amortized if area_forest_ is out of date,
+    // otherwise constant.
+    // Short rationale for estimate: Builds area_forest_ from areas_ (see AreaForest::build)
+    // only before the first area query, after clear_all, and after a cycle of subareas
+    // may have been broken. Otherwise the changes to areas_ are made to area_forest_ too.
+    void freeze_area_forest_();
+
+    // Estimate of performance: O(n log n) if areas have been added after the previous
+    // call, otherwise constant.
+    // Short rationale for estimate: Builds area_rtree_ from areas_ again only if it is
+    // out of date (see AreaRTree::build). Called by areas_containing.
+    void freeze_area_rtree_();
+
+    // Estimate of performance: Linear in the amount of coordinates.
+    // Short rationale for estimate: The shoelace terms are computed with cross_products
+    // in blocks, and the bounding box, doubled signed size and centroid of the shape
+    // are summed from them in one pass. The results are stored to area.
+    static void measure_shape_(std::vector<Coord> const& coords, Area & area);
+
+    // Estimate of performance: O(log n + k*s*t), as in build_area_hierarchy.
+    // Short rationale for estimate: The candidates from area_rtree_ that are larger than
+    // the area are sorted by size, and the first whose shape contains the shape of the area
+    // is returned, or NO_AREA. Only reads areas_ and area_rtree_, so that it can be called
+    // from many threads, each with its own buffers.
+    AreaID smallest_enclosing_area_(AreaID id, std::vector<std::pair<long long,AreaID>> & candidates,
+                                    std::vector<Coord> & inner, std::vector<Coord> & outer) const;
+
     // Estimate of performance: Linear. O(n). (O(V+E)).
     // Short rationale for estimate: This operation
     // executes DFS for the graph-structure, which
@@ -473,19 +2016,19 @@ private:
     // the amount of edges in a graph, according to the common knowledge
     // and lectures of this course. We can simplify its asymptotic efficiency
     // by stating that its complexity is O(n).
-    void DFS_route(Coord & fromxy, Coord & toxy);
+    void DFS_route(std::uint32_t from, std::uint32_t to);
 
     // Estimate of performance: Linear. O(n). (O(V+E)).
     // Short rationale for estimate: This operation
     // executes DFS for the graph-structure and tries to find if there
     // is a cycle in the graph. If a cycle is found, this method returns
-    // a pointer to the cycle-node. (the one that is founded twice by DFS)
-    // if cycle is not found, this returns nullptr.
+    // the cycle-node (the one that is founded twice by DFS) and the node and
+    // edge from which it was found again. If cycle is not found, this returns NO_NODE.
     // DFS's complexity is O(V+E), in which V is the amount of nodes in a graph, and E is
     // the amount of edges in a graph, according to the common knowledge
     // and lectures of this course. We can simplify its asymptotic efficiency
     // by stating that its complexity is O(n).
-    Node* DFS_cycle(Coord & fromxy);
+    std::uint32_t DFS_cycle(std::uint32_t from, std::uint32_t & cycle_previous_node, std::uint32_t & cycle_previous_edge);
 
     // Estimate of performance: Linear. O(n) (O(V+E)).
     // Short rationale for estimate: This operation
@@ -495,7 +2038,7 @@ private:
     // the amount of edges in a graph, according to the common knowledge
     // and lectures of this course.  We can simplify its asymptotic efficiency
     // by stating that its complexity is O(n).
-    void BFS(Coord & fromxy, Coord & toxy);
+    void BFS(std::uint32_t from, std::uint32_t to);
 
     // Estimate of performance: Linear. O(n)
     // Short rationale for estimate: This is a contributory method that tracks
@@ -512,7 +2055,7 @@ private:
     // first element of the vector. The complexity of reverse.() is O(n/2) and the
     // other methods called here are either constants or constanst on average but linear
     // in worst cases, so we can say that the complexity of this method is O(n).
-    std::vector<std::tuple<Coord, WayID, Distance>> track_route(Coord & route_end);
+    std::vector<std::tuple<Coord, WayID, Distance>> track_route(std::uint32_t route_end);
 
     // Estimate of performance: O(n*log(n)). ( O((V+E)*log (V) )
     // Short rationale for estimate: This operation
@@ -522,7 +2065,7 @@ private:
     // the amount of edges in a graph, according to the common knowledge
     // and lectures of this course.  We can simplify its asymptotic efficiency
     // by stating that its complexity is O(n*log(n)).
-    void A_star(Coord & fromxy, Coord & toxy);
+    void A_star(std::uint32_t from, std::uint32_t to);
 
     // Estimate of performance: O(n*log(n)). ( O((V+E)*log (V) )
     // Short rationale for estimate: This operation
@@ -532,12 +2075,84 @@ private:
     // the amount of edges in a graph, according to the common knowledge
     // and lectures of this course.  We can simplify its asymptotic efficiency
     // by stating that its complexity is O(n*log(n)).
-    void Dijkstra( Coord fromxy, bool restoreNodes);
-
-    std::unordered_map<PlaceID,Place> places_;
-    std::unordered_map<AreaID,Area> areas_;
-    std::unordered_map<WayID,Way> ways_;
-    std::unordered_map<Coord,Node,CoordHash> nodes_;
+    void Dijkstra(std::uint32_t from, bool restoreNodes);
+
+    // Names of places and areas, which are stored as handles to this pool.
+    NamePool name_pool_;
+    // Shapes of areas and coordinates of ways. They are released all at once by
+    // clear_all and clear_ways.
+    MonotonicArena areas_arena_;
+    MonotonicArena ways_arena_;
+    PlaceStore places_;
+    // Secondary index for find_places_name: IDs of all places having each name, indexed by name handle.
+    std::vector<std::unordered_set<PlaceID>> places_by_name_;
+    // Secondary index for find_places_type: one dense vector of IDs per PlaceType (NO_TYPE excluded).
+    std::array<std::vector<PlaceID>,static_cast<std::size_t>(PlaceType::NO_TYPE)> places_by_type_;
+    // Places ordered by (name, id) for places_alphabetically, and the latest result of it.
+    std::set<std::pair<NameHandle,PlaceID>,AlphabeticalOrder> places_in_alphabetical_order_{AlphabeticalOrder{&name_pool_}};
+    std::vector<PlaceID> alphabetical_order_cache_;
+    bool alphabetical_order_cache_valid_ = true;
+    // Places ordered by (squared distance from origo, y, id) for places_coord_order, and the latest result of it.
+    std::set<std::tuple<long long,int,PlaceID>> places_in_coord_order_;
+    std::vector<PlaceID> coord_order_cache_;
+    bool coord_order_cache_valid_ = true;
+    // Spatial indexes for places_closest_to: one grid per PlaceType, and the grid of all places at index NO_TYPE.
+    std::array<PlaceGrid,static_cast<std::size_t>(PlaceType::NO_TYPE)+1> place_grids_;
+    HashMap<AreaID,Area,IdHash> areas_;
+    HashMap<WayID,Way> ways_;
+    HashMap<Coord,Node,CoordHash> nodes_;
+    // Frozen read-optimized forms built by creation_finished. way_graph_ is built again by
+    // the next route search after the ways have changed. area_forest_ is built by the first
+    // area hierarchy query and then changed along with areas_ while area_forest_valid_. If
+    // the subareas form a cycle, the forest does not cover every area (area_forest_usable_
+    // is false) and the area queries read areas_ instead. area_rtree_ is built again by the
+    // next areas_containing after areas have been added or removed.
+    WayGraph way_graph_;
+    bool way_graph_valid_ = false;
+    AreaForest area_forest_;
+    bool area_forest_valid_ = false;
+    bool area_forest_usable_ = false;
+    AreaRTree area_rtree_;
+    bool area_rtree_valid_ = false;
+    // State of the latest route search for each crossroad of way_graph_.
+    std::vector<Status> node_status_;
+    std::vector<Distance> steps_taken_;
+    std::vector<Distance> route_distance_so_far_;
+    std::vector<std::uint32_t> previous_node_;
+    std::vector<std::uint32_t> previous_edge_;
+    // Work deferred by the bulk operations: the last deferred_places_ slots of places_
+    // are not in the secondary indexes of places, and deferred_ways_ are not in nodes_.
+    bool indexes_deferred_ = false;
+    std::size_t deferred_places_ = 0;
+    std::vector<WayID> deferred_ways_;
 };
 
+template<typename Visitor>
+void Datastructures::for_each_place(Visitor visit) const
+{
+    for (std::size_t slot = 0; slot < places_.size(); ++slot)
+    {
+        visit(PlaceView{places_.ids[slot], name_pool_.name(places_.names[slot]),
+                        places_.types[slot], places_.coord(slot)});
+    }
+}
+
+template<typename Visitor>
+void Datastructures::for_each_area(Visitor visit) const
+{
+    for (auto const& area : areas_)
+    {
+        visit(AreaView{area.first, name_pool_.name(area.second.areaName), area.second.shape});
+    }
+}
+
+template<typename Visitor>
+void Datastructures::for_each_way(Visitor visit) const
+{
+    for (auto const& way : ways_)
+    {
+        visit(WayView{way.first, way.second.coordinates, way.second.distance});
+    }
+}
+
 #endif // DATASTRUCTURES_HH
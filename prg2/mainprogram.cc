@@ -111,6 +111,11 @@ using std::back_inserter;
 #include <cstddef>
 #include <cassert>
 
+#ifdef COUNT_ALLOCATIONS
+#include <atomic>
+#include <new>
+#endif
+
 
 #include "mainprogram.hh"
 
@@ -122,6 +127,57 @@ using std::back_inserter;
 
 string const MainProgram::PROMPT = "> ";
 
+#ifdef COUNT_ALLOCATIONS
+// Counts every heap allocation made through operator new, so that perftest can
+// report how many allocations adding the data and running the commands took.
+namespace
+{
+std::atomic<unsigned long long> allocation_count{0};
+}
+
+// The replacements are not inlined, as GCC would otherwise see the std::free of an
+// inlined operator delete as freeing memory from operator new (-Wmismatched-new-delete).
+#if defined(__GNUC__)
+#define NOINLINE __attribute__((noinline))
+#else
+#define NOINLINE
+#endif
+
+NOINLINE void* operator new(std::size_t size)
+{
+    ++allocation_count;
+    if (void* ptr = std::malloc(size ? size : 1)) { return ptr; }
+    throw std::bad_alloc();
+}
+
+NOINLINE void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+NOINLINE void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+NOINLINE void operator delete[](void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+NOINLINE void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+NOINLINE void operator delete[](void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+#undef NOINLINE
+#endif
+
 MainProgram::CmdResult MainProgram::cmd_add_place(std::ostream& output, MatchIter begin, MatchIter end)
 {
     string idstr = *begin++;
@@ -213,14 +269,7 @@ MainProgram::CmdResult MainProgram::cmd_add_area(std::ostream& output, MainProgr
 
     AreaID id = convert_string_to<AreaID>(idstr);
 
-    vector<Coord> coords;
-    smatch coord;
-    auto sbeg = coordsstr.cbegin();
-    auto send = coordsstr.cend();
-    for ( ; regex_search(sbeg, send, coord, coords_regex_); sbeg = coord.suffix().first)
-    {
-        coords.push_back({convert_string_to<int>(coord[1]),convert_string_to<int>(coord[2])});
-    }
+    vector<Coord> coords = convert_string_to_coords(coordsstr);
 
     if (coords.size() < 3)
     {
@@ -394,14 +443,7 @@ MainProgram::CmdResult MainProgram::cmd_add_way(std::ostream& output, MainProgra
 
     WayID id = idstr;
 
-    vector<Coord> coords;
-    smatch coord;
-    auto sbeg = coordsstr.cbegin();
-    auto send = coordsstr.cend();
-    for ( ; regex_search(sbeg, send, coord, coords_regex_); sbeg = coord.suffix().first)
-    {
-        coords.push_back({convert_string_to<int>(coord[1]),convert_string_to<int>(coord[2])});
-    }
+    vector<Coord> coords = convert_string_to_coords(coordsstr);
 
     if (coords.size() < 2)
     {
@@ -477,6 +519,245 @@ void MainProgram::test_all_subareas_in_area()
     }
 }
 
+MainProgram::CmdResult MainProgram::cmd_is_subarea_of(std::ostream &output, MainProgram::MatchIter begin, MainProgram::MatchIter end)
+{
+    string idstr = *begin++;
+    string parentidstr = *begin++;
+    assert( begin == end && "Impossible number of parameters!");
+
+    AreaID id = convert_string_to<AreaID>(idstr);
+    AreaID parentid = convert_string_to<AreaID>(parentidstr);
+
+    bool inside = ds_.is_subarea_of(id, parentid);
+    output << "Area "; print_area(id, output, false);
+    output << (inside ? " is" : " is not") << " a subarea of area "; print_area(parentid, output);
+    return {};
+}
+
+void MainProgram::test_is_subarea_of()
+{
+    if (random_areas_added_ > 0) // Don't do anything if there's no places
+    {
+        auto id = n_to_areaid(random<decltype(random_areas_added_)>(0, random_areas_added_));
+        auto parentid = n_to_areaid(random<decltype(random_areas_added_)>(0, random_areas_added_));
+        ds_.is_subarea_of(id, parentid);
+    }
+}
+
+MainProgram::CmdResult MainProgram::cmd_areas_containing(std::ostream &output, MainProgram::MatchIter begin, MainProgram::MatchIter end)
+{
+    string xstr = *begin++;
+    string ystr = *begin++;
+    assert( begin == end && "Impossible number of parameters!");
+
+    Coord coord = {convert_string_to<int>(xstr),convert_string_to<int>(ystr)};
+
+    auto result = ds_.areas_containing(coord);
+    if (result.empty()) { output << "No areas!" << endl; }
+    return {ResultType::AREAIDLIST, result};
+}
+
+void MainProgram::test_areas_containing()
+{
+    if (random_areas_added_ > 0) // Don't do anything if there's no areas
+    {
+        auto x = random<int>(1, 10000);
+        auto y = random<int>(1, 10000);
+        ds_.areas_containing({x,y});
+    }
+}
+
+MainProgram::CmdResult MainProgram::cmd_places_in_area(std::ostream &output, MainProgram::MatchIter begin, MainProgram::MatchIter end)
+{
+    string idstr = *begin++;
+    string recursivestr = *begin++;
+    assert( begin == end && "Impossible number of parameters!");
+
+    AreaID id = convert_string_to<AreaID>(idstr);
+    bool recursive = !recursivestr.empty();
+
+    auto result = ds_.places_in_area(id, recursive);
+    if (result.empty()) { output << "No Places!" << endl; }
+    sort(result.begin(), result.end());
+    return {ResultType::PLACEIDLIST, CmdResultPlaceIDs{id, result}};
+}
+
+void MainProgram::test_places_in_area()
+{
+    if (random_areas_added_ > 0) // Don't do anything if there's no areas
+    {
+        auto id = n_to_areaid(random<decltype(random_areas_added_)>(0, random_areas_added_));
+        ds_.places_in_area(id, random(0, 2) == 1);
+    }
+}
+
+MainProgram::CmdResult MainProgram::cmd_area_bbox(std::ostream &output, MainProgram::MatchIter begin, MainProgram::MatchIter end)
+{
+    string idstr = *begin++;
+    assert( begin == end && "Impossible number of parameters!");
+
+    AreaID id = convert_string_to<AreaID>(idstr);
+
+    auto [min, max] = ds_.area_bbox(id);
+    if (min == NO_COORD && max == NO_COORD)
+    {
+        return {ResultType::AREAIDLIST, MainProgram::CmdResultAreaIDs{NO_AREA}};
+    }
+
+    output << "Area "; print_area(id,output,false); output << " has bounding box:" << endl;
+    print_coord(min,output);
+    print_coord(max,output);
+    return {ResultType::AREAIDLIST, MainProgram::CmdResultAreaIDs{id}};
+}
+
+void MainProgram::test_area_bbox()
+{
+    if (random_areas_added_ > 0) // Don't do anything if there's no areas
+    {
+        auto id = n_to_areaid(random<decltype(random_areas_added_)>(0, random_areas_added_));
+        ds_.area_bbox(id);
+    }
+}
+
+MainProgram::CmdResult MainProgram::cmd_area_size(std::ostream &output, MainProgram::MatchIter begin, MainProgram::MatchIter end)
+{
+    string idstr = *begin++;
+    assert( begin == end && "Impossible number of parameters!");
+
+    AreaID id = convert_string_to<AreaID>(idstr);
+
+    AreaSize size = ds_.area_size(id);
+    if (size == NO_AREA_SIZE)
+    {
+        return {ResultType::AREAIDLIST, MainProgram::CmdResultAreaIDs{NO_AREA}};
+    }
+
+    output << "Area "; print_area(id,output,false); output << " has size " << size << endl;
+    return {ResultType::AREAIDLIST, MainProgram::CmdResultAreaIDs{id}};
+}
+
+void MainProgram::test_area_size()
+{
+    if (random_areas_added_ > 0) // Don't do anything if there's no areas
+    {
+        auto id = n_to_areaid(random<decltype(random_areas_added_)>(0, random_areas_added_));
+        ds_.area_size(id);
+    }
+}
+
+MainProgram::CmdResult MainProgram::cmd_area_centroid(std::ostream &output, MainProgram::MatchIter begin, MainProgram::MatchIter end)
+{
+    string idstr = *begin++;
+    assert( begin == end && "Impossible number of parameters!");
+
+    AreaID id = convert_string_to<AreaID>(idstr);
+
+    Coord centroid = ds_.area_centroid(id);
+    if (centroid == NO_COORD)
+    {
+        return {ResultType::AREAIDLIST, MainProgram::CmdResultAreaIDs{NO_AREA}};
+    }
+
+    output << "Area "; print_area(id,output,false); output << " has centroid ";
+    print_coord(centroid,output);
+    return {ResultType::AREAIDLIST, MainProgram::CmdResultAreaIDs{id}};
+}
+
+void MainProgram::test_area_centroid()
+{
+    if (random_areas_added_ > 0) // Don't do anything if there's no areas
+    {
+        auto id = n_to_areaid(random<decltype(random_areas_added_)>(0, random_areas_added_));
+        ds_.area_centroid(id);
+    }
+}
+
+MainProgram::CmdResult MainProgram::cmd_build_area_hierarchy(std::ostream& output, MainProgram::MatchIter /*begin*/, MainProgram::MatchIter /*end*/)
+{
+    auto added = ds_.build_area_hierarchy();
+    output << "Added " << added << " subareas." << endl;
+
+    return {};
+}
+
+void MainProgram::test_build_area_hierarchy()
+{
+    ds_.build_area_hierarchy();
+}
+
+MainProgram::CmdResult MainProgram::cmd_remove_area(std::ostream& output, MatchIter begin, MatchIter end)
+{
+    string idstr = *begin++;
+    assert( begin == end && "Impossible number of parameters!");
+
+    AreaID id = convert_string_to<AreaID>(idstr);
+    auto name = ds_.get_area_name(id);
+    bool success = ds_.remove_area(id);
+    if (success)
+    {
+        output << "Area " << name << " removed." << endl;
+        view_dirty = true;
+        return {};
+    }
+    else
+    {
+        return {ResultType::AREAIDLIST, MainProgram::CmdResultAreaIDs{NO_AREA}};
+    }
+}
+
+void MainProgram::test_remove_area()
+{
+    // Choose random number to remove
+    if (random_areas_added_ > 0) // Don't remove if there's nothing to remove
+    {
+        auto id = n_to_areaid(random<decltype(random_areas_added_)>(0, random_areas_added_));
+        ds_.remove_area(id);
+    }
+}
+
+MainProgram::CmdResult MainProgram::cmd_move_subarea(std::ostream& output, MainProgram::MatchIter begin, MainProgram::MatchIter end)
+{
+    string sourceidstr = *begin++;
+    string targetidstr = *begin++;
+    assert( begin == end && "Impossible number of parameters!");
+
+    AreaID sourceid = convert_string_to<AreaID>(sourceidstr);
+    AreaID targetid = targetidstr.empty() ? NO_AREA : convert_string_to<AreaID>(targetidstr);
+
+    view_dirty = true;
+
+    bool ok = ds_.move_subarea(sourceid, targetid);
+    if (ok)
+    {
+        auto sourcename = ds_.get_area_name(sourceid);
+        if (targetid == NO_AREA)
+        {
+            output << "Moved subarea " << sourcename << " to the top level" << endl;
+        }
+        else
+        {
+            auto targetname = ds_.get_area_name(targetid);
+            output << "Moved subarea " << sourcename << " to area " << targetname << endl;
+        }
+    }
+    else
+    {
+        output << "Moving subarea failed!" << endl;
+    }
+
+    return {};
+}
+
+void MainProgram::test_move_subarea()
+{
+    if (random_areas_added_ > 0) // Don't do anything if there's no areas
+    {
+        auto id = n_to_areaid(random<decltype(random_areas_added_)>(0, random_areas_added_));
+        auto parentid = n_to_areaid(random<decltype(random_areas_added_)>(0, random_areas_added_));
+        ds_.move_subarea(id, parentid);
+    }
+}
+
 MainProgram::CmdResult MainProgram::cmd_places_closest_to(std::ostream& /*output*/, MainProgram::MatchIter begin, MainProgram::MatchIter end)
 {
   string xstr = *begin++;
@@ -506,6 +787,108 @@ void MainProgram::test_places_closest_to()
     }
 }
 
+MainProgram::CmdResult MainProgram::cmd_places_nearest(std::ostream& output, MainProgram::MatchIter begin, MainProgram::MatchIter end)
+{
+    string xstr = *begin++;
+    string ystr = *begin++;
+    string kstr = *begin++;
+    string typestr = *begin++;
+    assert( begin == end && "Impossible number of parameters!");
+
+    Coord coord = {convert_string_to<int>(xstr),convert_string_to<int>(ystr)};
+    int k = convert_string_to<int>(kstr);
+    PlaceType type = PlaceType::NO_TYPE;
+    if (!typestr.empty())
+    {
+        type = convert_string_to_placetype(typestr);
+    }
+
+    auto result = ds_.places_nearest(coord, type, k);
+    if (result.empty()) { output << "No Places!" << endl; }
+    return {ResultType::PLACEIDLIST, CmdResultPlaceIDs{NO_AREA, result}};
+}
+
+void MainProgram::test_places_nearest()
+{
+    if (random_places_added_ > 0) // Don't do anything if there's no places
+    {
+        auto x = random<int>(1, 10000);
+        auto y = random<int>(1, 10000);
+        auto k = random<int>(1, 20);
+        PlaceType type{random(0, static_cast<int>(PlaceType::NO_TYPE))};
+        ds_.places_nearest({x,y}, type, k);
+    }
+}
+
+MainProgram::CmdResult MainProgram::cmd_places_within_radius(std::ostream& output, MainProgram::MatchIter begin, MainProgram::MatchIter end)
+{
+    string xstr = *begin++;
+    string ystr = *begin++;
+    string radiusstr = *begin++;
+    string typestr = *begin++;
+    assert( begin == end && "Impossible number of parameters!");
+
+    Coord coord = {convert_string_to<int>(xstr),convert_string_to<int>(ystr)};
+    Distance radius = convert_string_to<Distance>(radiusstr);
+    PlaceType type = PlaceType::NO_TYPE;
+    if (!typestr.empty())
+    {
+        type = convert_string_to_placetype(typestr);
+    }
+
+    auto result = ds_.places_within_radius(coord, radius, type);
+    if (result.empty()) { output << "No Places!" << endl; }
+    return {ResultType::PLACEIDLIST, CmdResultPlaceIDs{NO_AREA, result}};
+}
+
+void MainProgram::test_places_within_radius()
+{
+    if (random_places_added_ > 0) // Don't do anything if there's no places
+    {
+        auto x = random<int>(1, 10000);
+        auto y = random<int>(1, 10000);
+        auto radius = random<Distance>(0, 100);
+        PlaceType type{random(0, static_cast<int>(PlaceType::NO_TYPE))};
+        ds_.places_within_radius({x,y}, radius, type);
+    }
+}
+
+MainProgram::CmdResult MainProgram::cmd_places_in_rect(std::ostream& output, MainProgram::MatchIter begin, MainProgram::MatchIter end)
+{
+    string minxstr = *begin++;
+    string minystr = *begin++;
+    string maxxstr = *begin++;
+    string maxystr = *begin++;
+    string typestr = *begin++;
+    assert( begin == end && "Impossible number of parameters!");
+
+    Coord min = {convert_string_to<int>(minxstr),convert_string_to<int>(minystr)};
+    Coord max = {convert_string_to<int>(maxxstr),convert_string_to<int>(maxystr)};
+    PlaceType type = PlaceType::NO_TYPE;
+    if (!typestr.empty())
+    {
+        type = convert_string_to_placetype(typestr);
+    }
+
+    auto result = ds_.places_in_rect(min, max, type);
+    if (result.empty()) { output << "No Places!" << endl; }
+    sort(result.begin(), result.end());
+    return {ResultType::PLACEIDLIST, CmdResultPlaceIDs{NO_AREA, result}};
+}
+
+void MainProgram::test_places_in_rect()
+{
+    if (random_places_added_ > 0) // Don't do anything if there's no places
+    {
+        auto x = random<int>(1, 10000);
+        auto y = random<int>(1, 10000);
+        auto width = random<int>(0, 200);
+        auto height = random<int>(0, 200);
+        PlaceType type{random(0, static_cast<int>(PlaceType::NO_TYPE))};
+        ds_.places_in_rect({x,y}, {x+width,y+height}, type);
+    }
+}
+
 MainProgram::CmdResult MainProgram::cmd_common_area_of_subareas(std::ostream &output, MainProgram::MatchIter begin, MainProgram::MatchIter end)
 {
     string id1str = *begin++;
@@ -784,7 +1167,27 @@ MainProgram::CmdResult MainProgram::cmd_read(std::ostream& output, MatchIter beg
     if (input)
     {
         output << "** Commands from '" << filename << "'" << endl;
-        command_parser(input, *new_output, PromptStyle::NORMAL);
+        // The output of a silent read is not shown, so a file of only additions (like the
+        // data files) can be added with the bulk operations instead of command by command.
+        bool bulk_read = false;
+        if (silent)
+        {
+            vector<string> lines;
+            for (string line; getline(input, line); )
+            {
+                lines.push_back(line);
+            }
+            bulk_read = read_bulk(lines);
+            if (!bulk_read)
+            {
+                input.clear();
+                input.seekg(0);
+            }
+        }
+        if (!bulk_read)
+        {
+            command_parser(input, *new_output, PromptStyle::NORMAL);
+        }
         if (silent) { output << "...(output discarded in silent mode)..." << endl; }
         output << "** End of commands from '" << filename << "'" << endl;
     }
@@ -796,6 +1199,83 @@ MainProgram::CmdResult MainProgram::cmd_read(std::ostream& output, MatchIter beg
     return {};
 }
 
+bool MainProgram::read_bulk(std::vector<std::string> const& lines)
+{
+    // Areas are added in batches that end at an add_subarea_to_area, so that
+    // each subarea is added when exactly the same areas exist as when the
+    // commands are run one by one. Places and ways do not depend on areas.
+    struct AreaBatch
+    {
+        vector<tuple<AreaID, Name, vector<Coord>>> areas;
+        vector<pair<AreaID, AreaID>> subareas;
+    };
+    vector<tuple<PlaceID, Name, PlaceType, Coord>> places;
+    vector<pair<WayID, vector<Coord>>> ways;
+    vector<AreaBatch> area_batches(1);
+
+    for (string const& line : lines)
+    {
+        if (line.empty()) { continue; }
+
+        smatch match;
+        if (!regex_match(line, match, cmds_regex_)) { return false; }
+        string cmd = match[1];
+        string params = match[2];
+        if (cmd == "#") { continue; }
+        if (cmd != "add_place" && cmd != "add_area" && cmd != "add_subarea_to_area" && cmd != "add_way") { return false; }
+
+        auto pos = find_if(cmds_.begin(), cmds_.end(), [cmd](CmdInfo const& ci) { return ci.cmd == cmd; });
+        smatch params_match;
+        if (!regex_match(params, params_match, pos->param_regex)) { return false; }
+
+        // A command whose parameters cannot be converted would only print an error
+        // (discarded in silent mode), so it is skipped the same way.
+        try
+        {
+            if (cmd == "add_place")
+            {
+                PlaceType type = convert_string_to_placetype(params_match[3]);
+                Coord xy = {convert_string_to<int>(params_match[4]), convert_string_to<int>(params_match[5])};
+                places.emplace_back(convert_string_to<PlaceID>(params_match[1]), params_match[2], type, xy);
+            }
+            else if (cmd == "add_area")
+            {
+                AreaID id = convert_string_to<AreaID>(params_match[1]);
+                vector<Coord> coords = convert_string_to_coords(params_match[3]);
+                if (coords.size() < 3) { continue; }
+                if (!area_batches.back().subareas.empty()) { area_batches.emplace_back(); }
+                area_batches.back().areas.emplace_back(id, params_match[2], move(coords));
+            }
+            else if (cmd == "add_subarea_to_area")
+            {
+                area_batches.back().subareas.emplace_back(convert_string_to<AreaID>(params_match[1]), convert_string_to<AreaID>(params_match[2]));
+            }
+            else
+            {
+                vector<Coord> coords = convert_string_to_coords(params_match[2]);
+                if (coords.size() < 2) { continue; }
+                ways.emplace_back(params_match[1], move(coords));
+            }
+        }
+        catch (std::exception const&)
+        {
+        }
+    }
+
+    ds_.add_places_bulk(places);
+    ds_.add_ways_bulk(ways);
+    for (auto const& batch : area_batches)
+    {
+        ds_.add_areas_bulk(batch.areas);
+        for (auto const& [sourceid, targetid] : batch.subareas)
+        {
+            ds_.add_subarea_to_area(sourceid, targetid);
+        }
+    }
+    view_dirty = true;
+
+    return true;
+}
 
 MainProgram::CmdResult MainProgram::cmd_testread(std::ostream& output, MatchIter begin, MatchIter end)
 {
@@ -1013,11 +1493,10 @@ std::string MainProgram::print_place(PlaceID id, ostream& output, bool nl)
 {
     if (id != NO_PLACE)
     {
-        auto [name,type] = ds_.get_place_name_type(id);
-        auto xy = ds_.get_place_coord(id);
-        if (!name.empty())
+        auto place = ds_.place_view(id);
+        if (!place.name.empty())
         {
-            output << name << " (" << convert_placetype_to_string(type) << ")";
+            output << place.name << " (" << convert_placetype_to_string(place.type) << ")";
         }
         else
         {
@@ -1025,7 +1504,7 @@ std::string MainProgram::print_place(PlaceID id, ostream& output, bool nl)
         }
 
          output << ": pos=";
-         print_coord(xy, output, false);
+         print_coord(place.coord, output, false);
          output << ", id=" << id;
          if (nl) { output << endl; }
 
@@ -1045,7 +1524,7 @@ std::string MainProgram::print_place_name(PlaceID id, std::ostream &output, bool
 {
     if (id != NO_PLACE)
     {
-        auto [name,type] = ds_.get_place_name_type(id);
+        auto name = ds_.place_view(id).name;
         if (!name.empty())
         {
             output << name;
@@ -1072,7 +1551,7 @@ std::string MainProgram::print_area(AreaID id, std::ostream& output, bool nl)
 {
     if (id != NO_AREA)
     {
-        auto name = ds_.get_area_name(id);
+        auto name = ds_.area_view(id).name;
         if (!name.empty())
         {
             output << name << ": id=" << id;
@@ -1155,6 +1634,61 @@ void MainProgram::test_find_places_name()
     }
 }
 
+MainProgram::CmdResult MainProgram::cmd_find_places_name_prefix(std::ostream& output, MatchIter begin, MatchIter end)
+{
+    string prefix = *begin++;
+    string limitstr = *begin++;
+    assert( begin == end && "Impossible number of parameters!");
+
+    int limit = convert_string_to<int>(limitstr);
+
+    auto result = ds_.find_places_name_prefix(prefix, limit);
+    if (result.empty())
+    {
+        output << "No Places!" << std::endl;
+    }
+
+    return {ResultType::PLACEIDLIST, CmdResultPlaceIDs{NO_AREA, result}};
+}
+
+void MainProgram::test_find_places_name_prefix()
+{
+    if (random_places_added_ > 0) // Don't find if there's nothing to find
+    {
+        auto name = n_to_name(random<decltype(random_places_added_)>(0, random_places_added_));
+        auto prefix = name.substr(0, random<std::string::size_type>(1, name.size()+1));
+        ds_.find_places_name_prefix(prefix, 10);
+    }
+}
+
+MainProgram::CmdResult MainProgram::cmd_find_places_fuzzy(std::ostream& output, MatchIter begin, MatchIter end)
+{
+    string query = *begin++;
+    string maxstr = *begin++;
+    assert( begin == end && "Impossible number of parameters!");
+
+    int max_results = convert_string_to<int>(maxstr);
+
+    auto result = ds_.find_places_fuzzy(query, max_results);
+    if (result.empty())
+    {
+        output << "No Places!" << std::endl;
+    }
+
+    return {ResultType::PLACEIDLIST, CmdResultPlaceIDs{NO_AREA, result}};
+}
+
+void MainProgram::test_find_places_fuzzy()
+{
+    if (random_places_added_ > 0) // Don't find if there's nothing to find
+    {
+        // Misspell an existing name by replacing one letter
+        auto name = n_to_name(random<decltype(random_places_added_)>(0, random_places_added_));
+        name[random<std::string::size_type>(0, name.size())] = 'a'+random(0, 26);
+        ds_.find_places_fuzzy(name, 5);
+    }
+}
+
 MainProgram::CmdResult MainProgram::cmd_find_places_type(std::ostream &output, MainProgram::MatchIter begin, MainProgram::MatchIter end)
 {
     string typestr = *begin++;
@@ -1467,8 +2001,8 @@ string const wayidx = "([a-zA-Z0-9]+)";
 string const namex = "'([a-zA-Z0-9 -]+)'";
 string const typex = "([a-zA-Z0-9]+)";
 string const numx = "([0-9]+)";
-string const optcoordx = "\\([[:space:]]*[0-9]+[[:space:]]*,[[:space:]]*[0-9]+[[:space:]]*\\)";
-string const coordx = "\\([[:space:]]*([0-9]+)[[:space:]]*,[[:space:]]*([0-9]+)[[:space:]]*\\)";
+string const optcoordx = "\\([[:space:]]*-?[0-9]+[[:space:]]*,[[:space:]]*-?[0-9]+[[:space:]]*\\)";
+string const coordx = "\\([[:space:]]*(-?[0-9]+)[[:space:]]*,[[:space:]]*(-?[0-9]+)[[:space:]]*\\)";
 string const wsx = "[[:space:]]+";
 
 vector<MainProgram::CmdInfo> MainProgram::cmds_ =
@@ -1489,13 +2023,20 @@ vector<MainProgram::CmdInfo> MainProgram::cmds_ =
     {"places_alphabetically", "", "", &MainProgram::NoParPlaceListCmd<&Datastructures::places_alphabetically>, &MainProgram::NoParPlaceListTestCmd<&Datastructures::places_alphabetically> },
     {"places_coord_order", "", "", &MainProgram::NoParPlaceListCmd<&Datastructures::places_coord_order>, &MainProgram::NoParPlaceListTestCmd<&Datastructures::places_coord_order> },
     {"places_closest_to", "Coord [type] (type optional)", coordx+"(?:"+wsx+typex+")?", &MainProgram::cmd_places_closest_to, &MainProgram::test_places_closest_to },
+    {"places_nearest", "Coord k [type] (type optional)", coordx+wsx+numx+"(?:"+wsx+typex+")?", &MainProgram::cmd_places_nearest, &MainProgram::test_places_nearest },
+    {"places_within_radius", "Coord radius [type] (type optional)", coordx+wsx+numx+"(?:"+wsx+typex+")?", &MainProgram::cmd_places_within_radius, &MainProgram::test_places_within_radius },
+    {"places_in_rect", "CoordMin CoordMax [type] (type optional)", coordx+wsx+coordx+"(?:"+wsx+typex+")?", &MainProgram::cmd_places_in_rect, &MainProgram::test_places_in_rect },
     {"common_area_of_subareas", "ID1 ID2", plcidx+wsx+plcidx, &MainProgram::cmd_common_area_of_subareas, &MainProgram::test_common_area_of_subareas },
     {"remove_place", "ID", plcidx, &MainProgram::cmd_remove_place, &MainProgram::test_remove_place },
     {"find_places_name", "'Name'", namex, &MainProgram::cmd_find_places_name, &MainProgram::test_find_places_name },
+    {"find_places_name_prefix", "'Prefix' limit", "'([a-zA-Z0-9 -]*)'"+wsx+numx, &MainProgram::cmd_find_places_name_prefix, &MainProgram::test_find_places_name_prefix },
+    {"find_places_fuzzy", "'Name' max_results", namex+wsx+numx, &MainProgram::cmd_find_places_fuzzy, &MainProgram::test_find_places_fuzzy },
     {"find_places_type", "type", typex, &MainProgram::cmd_find_places_type, &MainProgram::test_find_places_type },
     {"change_place_name", "ID 'Newname'", plcidx+wsx+namex, &MainProgram::cmd_change_place_name, &MainProgram::test_change_place_name },
     {"change_place_coord", "ID (x,y)", plcidx+wsx+coordx, &MainProgram::cmd_change_place_coord, &MainProgram::test_change_place_coord },
     {"add_subarea_to_area", "SubareaID AreaID", areaidx+wsx+areaidx, &MainProgram::cmd_add_subarea_to_area, nullptr },
+    {"move_subarea", "SubareaID [AreaID] (AreaID optional, without it the subarea is moved to the top level)", areaidx+"(?:"+wsx+areaidx+")?", &MainProgram::cmd_move_subarea, &MainProgram::test_move_subarea },
+    {"remove_area", "AreaID", areaidx, &MainProgram::cmd_remove_area, &MainProgram::test_remove_area },
     {"all_ways", "", "", &MainProgram::cmd_all_ways, nullptr },
     {"add_way", "WayID (x,y) (x,y)...", wayidx+"((?:"+wsx+optcoordx+")+)", &MainProgram::cmd_add_way, nullptr },
     {"way_coords", "WayID", wayidx, &MainProgram::cmd_way_coords, &MainProgram::test_way_coords },
@@ -1504,6 +2045,13 @@ vector<MainProgram::CmdInfo> MainProgram::cmds_ =
     {"remove_way", "WayID", wayidx, &MainProgram::cmd_remove_way, &MainProgram::test_remove_way },
     {"subarea_in_areas", "AreaID", areaidx, &MainProgram::cmd_subarea_in_areas, &MainProgram::test_subarea_in_areas },
     {"all_subareas_in_area", "AreaID", areaidx, &MainProgram::cmd_all_subareas_in_area, &MainProgram::test_all_subareas_in_area },
+    {"is_subarea_of", "SubareaID AreaID", areaidx+wsx+areaidx, &MainProgram::cmd_is_subarea_of, &MainProgram::test_is_subarea_of },
+    {"areas_containing", "Coord", coordx, &MainProgram::cmd_areas_containing, &MainProgram::test_areas_containing },
+    {"places_in_area", "AreaID [recursive] (recursive optional)", areaidx+"(?:"+wsx+"(recursive))?", &MainProgram::cmd_places_in_area, &MainProgram::test_places_in_area },
+    {"area_bbox", "AreaID", areaidx, &MainProgram::cmd_area_bbox, &MainProgram::test_area_bbox },
+    {"area_size", "AreaID", areaidx, &MainProgram::cmd_area_size, &MainProgram::test_area_size },
+    {"area_centroid", "AreaID", areaidx, &MainProgram::cmd_area_centroid, &MainProgram::test_area_centroid },
+    {"build_area_hierarchy", "", "", &MainProgram::cmd_build_area_hierarchy, &MainProgram::test_build_area_hierarchy },
     {"route_any", "CoordFrom CoordTo", coordx+wsx+coordx, &MainProgram::cmd_route_any, &MainProgram::test_route_any },
     {"route_least_crossroads", "CoordFrom CoordTo", coordx+wsx+coordx, &MainProgram::cmd_route_least_crossroads, &MainProgram::test_route_least_crossroads },
     {"route_shortest_distance", "CoordFrom CoordTo", coordx+wsx+coordx, &MainProgram::cmd_route_shortest_distance, &MainProgram::test_route_shortest_distance },
@@ -1537,9 +2085,9 @@ MainProgram::CmdResult MainProgram::cmd_perftest(std::ostream& output, MatchIter
     output << "WARNING: Debug STL enabled, performance will be worse than expected (maybe also asymptotically)!" << endl;
 #endif // _GLIBCXX_DEBUG
 
-    vector<string> optional_cmds({"places_closest_to", "places_common_area", "route_least_crossroads", "route_with_cycle", "route_shortest_distance",
+    vector<string> optional_cmds({"places_closest_to", "places_nearest", "places_within_radius", "places_in_rect", "find_places_name_prefix", "find_places_fuzzy", "is_subarea_of", "areas_containing", "places_in_area", "area_bbox", "area_size", "area_centroid", "build_area_hierarchy", "move_subarea", "remove_area", "places_common_area", "route_least_crossroads", "route_with_cycle", "route_shortest_distance",
                                   "add_walking_connections"});
-    vector<string> nondefault_cmds({"remove_place", "find_places", "way_coords"});
+    vector<string> nondefault_cmds({"remove_place", "remove_area", "build_area_hierarchy", "find_places", "way_coords"});
 
     string commandstr = *begin++;
     unsigned int timeout = convert_string_to<unsigned int>(*begin++);
@@ -1621,7 +2169,11 @@ MainProgram::CmdResult MainProgram::cmd_perftest(std::ostream& output, MatchIter
            << setw(12) << "cmds (count)"  << " , " << setw(12) << "total (sec)" << " , " << setw(12) << "total (count)" << endl;
 #else
     output << setw(7) << "N" << " , " << setw(12) << "add (sec)" << " , " << setw(12) << "cmds (sec)" << " , "
-           << setw(12) << "total (sec)" << endl;
+           << setw(12) << "total (sec)";
+#ifdef COUNT_ALLOCATIONS
+    output << " , " << setw(12) << "add (allocs)" << " , " << setw(12) << "cmds (allocs)";
+#endif
+    output << endl;
 #endif
     flush_output(output);
 
@@ -1637,6 +2189,9 @@ MainProgram::CmdResult MainProgram::cmd_perftest(std::ostream& output, MatchIter
         init_primes();
 
         Stopwatch stopwatch(true); // Use also instruction counting, if enabled
+#ifdef COUNT_ALLOCATIONS
+        auto allocs_at_start = allocation_count.load();
+#endif
 
         // Add random places
         for (unsigned int i = 0; i < n / 1000; ++i)
@@ -1698,6 +2253,9 @@ MainProgram::CmdResult MainProgram::cmd_perftest(std::ostream& output, MatchIter
 
 #ifdef USE_PERF_EVENT
         auto addcount = stopwatch.count();
+#endif
+#ifdef COUNT_ALLOCATIONS
+        auto addallocs = allocation_count.load() - allocs_at_start;
 #endif
         auto addsec = stopwatch.elapsed();
 
@@ -1766,6 +2324,9 @@ MainProgram::CmdResult MainProgram::cmd_perftest(std::ostream& output, MatchIter
         output << setw(12) << totalsec-addsec << " , " << setw(12) << totalcount-addcount << " , " << setw(12) << totalsec << " , " << setw(12) << totalcount;
 #else
         output << setw(12) << totalsec-addsec << " , " << setw(12) << totalsec;
+#ifdef COUNT_ALLOCATIONS
+        output << " , " << setw(12) << addallocs << " , " << setw(12) << allocation_count.load() - allocs_at_start - addallocs;
+#endif
 #endif
 
 //        unsigned long int maxmem;
@@ -2114,6 +2675,19 @@ int MainProgram::mainprogram(int argc, char* argv[])
     }
 }
 
+std::vector<Coord> MainProgram::convert_string_to_coords(std::string const& from)
+{
+    vector<Coord> coords;
+    smatch coord;
+    auto sbeg = from.cbegin();
+    auto send = from.cend();
+    for ( ; regex_search(sbeg, send, coord, coords_regex_); sbeg = coord.suffix().first)
+    {
+        coords.push_back({convert_string_to<int>(coord[1]),convert_string_to<int>(coord[2])});
+    }
+    return coords;
+}
+
 PlaceType MainProgram::convert_string_to_placetype(std::string from)
 {
     std::istringstream istr(from);
@@ -117,6 +117,8 @@ private:
     CmdResult cmd_area_coords(std::ostream& output, MatchIter begin, MatchIter end);
     CmdResult cmd_creation_finished(std::ostream& output, MatchIter begin, MatchIter end);
     CmdResult cmd_find_places_name(std::ostream& output, MatchIter begin, MatchIter end);
+    CmdResult cmd_find_places_name_prefix(std::ostream& output, MatchIter begin, MatchIter end);
+    CmdResult cmd_find_places_fuzzy(std::ostream& output, MatchIter begin, MatchIter end);
     CmdResult cmd_find_places_type(std::ostream& output, MatchIter begin, MatchIter end);
     CmdResult cmd_change_place_name(std::ostream& output, MatchIter begin, MatchIter end);
     CmdResult cmd_change_place_coord(std::ostream& output, MatchIter begin, MatchIter end);
@@ -124,7 +126,19 @@ private:
     CmdResult cmd_add_subarea_to_area(std::ostream& output, MatchIter begin, MatchIter end);
     CmdResult cmd_subarea_in_areas(std::ostream& output, MatchIter begin, MatchIter end);
     CmdResult cmd_all_subareas_in_area(std::ostream& output, MatchIter begin, MatchIter end);
+    CmdResult cmd_is_subarea_of(std::ostream& output, MatchIter begin, MatchIter end);
+    CmdResult cmd_areas_containing(std::ostream& output, MatchIter begin, MatchIter end);
+    CmdResult cmd_places_in_area(std::ostream& output, MatchIter begin, MatchIter end);
+    CmdResult cmd_area_bbox(std::ostream& output, MatchIter begin, MatchIter end);
+    CmdResult cmd_area_size(std::ostream& output, MatchIter begin, MatchIter end);
+    CmdResult cmd_area_centroid(std::ostream& output, MatchIter begin, MatchIter end);
+    CmdResult cmd_build_area_hierarchy(std::ostream& output, MatchIter begin, MatchIter end);
+    CmdResult cmd_remove_area(std::ostream& output, MatchIter begin, MatchIter end);
+    CmdResult cmd_move_subarea(std::ostream& output, MatchIter begin, MatchIter end);
     CmdResult cmd_places_closest_to(std::ostream& output, MatchIter begin, MatchIter end);
+    CmdResult cmd_places_nearest(std::ostream& output, MatchIter begin, MatchIter end);
+    CmdResult cmd_places_within_radius(std::ostream& output, MatchIter begin, MatchIter end);
+    CmdResult cmd_places_in_rect(std::ostream& output, MatchIter begin, MatchIter end);
     CmdResult cmd_common_area_of_subareas(std::ostream& output, MatchIter begin, MatchIter end);
     CmdResult cmd_all_ways(std::ostream& output, MatchIter begin, MatchIter end);
     CmdResult cmd_add_way(std::ostream& output, MatchIter begin, MatchIter end);
@@ -150,13 +164,27 @@ private:
     void test_place_name_type();
     void test_place_coord();
     void test_find_places_name();
+    void test_find_places_name_prefix();
+    void test_find_places_fuzzy();
     void test_find_places_type();
     void test_change_place_name();
     void test_change_place_coord();
     void test_area_name();
     void test_subarea_in_areas();
     void test_all_subareas_in_area();
+    void test_is_subarea_of();
+    void test_areas_containing();
+    void test_places_in_area();
+    void test_area_bbox();
+    void test_area_size();
+    void test_area_centroid();
+    void test_build_area_hierarchy();
+    void test_remove_area();
+    void test_move_subarea();
     void test_places_closest_to();
+    void test_places_nearest();
+    void test_places_within_radius();
+    void test_places_in_rect();
     void test_remove_place();
     void test_common_area_of_subareas();
     void test_ways_from();
@@ -170,6 +198,7 @@ private:
 
     void add_random_places_areas(unsigned int size, Coord min = {1,1}, Coord max = {10000, 10000});
     void add_random_ways(unsigned int n);
+    bool read_bulk(std::vector<std::string> const& lines);
     std::string print_place(PlaceID id, std::ostream& output, bool nl = true);
     std::string print_place_name(PlaceID id, std::ostream& output, bool nl = true);
     std::string print_area(AreaID id, std::ostream& output, bool nl = true);
@@ -185,6 +214,7 @@ private:
 
     static PlaceType convert_string_to_placetype(std::string from);
     static std::string convert_placetype_to_string(PlaceType type);
+    std::vector<Coord> convert_string_to_coords(std::string const& from);
 
     template<PlaceID(Datastructures::*MFUNC)()>
     CmdResult NoParPlaceCmd(std::ostream& output, MatchIter begin, MatchIter end);
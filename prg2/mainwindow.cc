@@ -172,25 +172,20 @@ void MainWindow::update_view()
 
     if (ui->places_checkbox->isChecked())
     {
-        auto places = mainprg_.ds_.all_places();
-        if (!errors && places.size() == 1 && places.front() == NO_PLACE)
-        {
-            errorout << "Error from GUI: all_places() returned error {NO_PLACE}" << std::endl;
-            errors = true;
-        }
-
-        for (auto placeid : places)
+        // The places are read through views, so names and coordinates are not copied
+        mainprg_.ds_.for_each_place([&](PlaceView const& place)
         {
+            auto placeid = place.id;
             QColor placecolor = Qt::white;
             QColor namecolor = Qt::cyan;
             QColor placeborder = Qt::white;
             int placezvalue = 1;
 
-            auto xy = mainprg_.ds_.get_place_coord(placeid);
+            auto xy = place.coord;
             auto [x,y] = xy;
             if (!errors && (x == NO_VALUE || y == NO_VALUE))
             {
-                errorout << "Error from GUI: get_place_coord(" << placeid << ") returned error (";
+                errorout << "Error from GUI: coordinate of place " << placeid << " is (";
                 if (xy == NO_COORD)
                 {
                     errorout << "NO_COORD";
@@ -242,14 +237,13 @@ void MainWindow::update_view()
                 string label = prefix;
                 if (ui->placenames_checkbox->isChecked())
                 {
-                    auto [name,type] = mainprg_.ds_.get_place_name_type(placeid);
-                    if (!errors && name == NO_NAME)
+                    if (!errors && place.name == NO_NAME)
                     {
-                        errorout << "GUI error: get_stop_name(" << placeid << ") returned error {NO_NAME}" << std::endl;
+                        errorout << "GUI error: name of place " << placeid << " is {NO_NAME}" << std::endl;
                         errors = true;
                     }
 
-                    label += name;
+                    label += place.name;
                 }
 
                 if (!label.empty())
@@ -271,7 +265,7 @@ void MainWindow::update_view()
                 groupitem->setPos(20*x, -20*y);
                 groupitem->setZValue(placezvalue);
             }
-        }
+        });
     }
 
     // Draw areas
@@ -288,15 +282,9 @@ void MainWindow::update_view()
             resultareas.insert(prevresult.begin(), prevresult.end());
         }
 
-        auto areaids = mainprg_.ds_.all_areas();
-        if (!errors && areaids.size() == 1 && areaids.front() == NO_AREA)
-        {
-            errorout << "GUI error: all_regions() returned error {NO_REGION}" << std::endl;
-            errors = true;
-        }
-
-        for (auto areaid : areaids)
+        mainprg_.ds_.for_each_area([&](AreaView const& area)
         {
+            auto areaid = area.id;
             QColor areacolor = Qt::blue;
             int areazvalue = -3;
 
@@ -307,10 +295,10 @@ void MainWindow::update_view()
                     areacolor = Qt::green;
                     areazvalue = -2;
                 }
-                auto coords = mainprg_.ds_.get_area_coords(areaid);
+                auto coords = area.shape;
                 if (!errors && (coords.size() < 3 || std::find(coords.begin(), coords.end(), NO_COORD) != coords.end()))
                 {
-                    errorout << "GUI error: get_area_coords(" << areaid << ") returned error { ";
+                    errorout << "GUI error: shape of area " << areaid << " is { ";
                     for (auto& coord : coords)
                     {
                         mainprg_.print_coord(coord, errorout);
@@ -344,18 +332,17 @@ void MainWindow::update_view()
                     lineitem->setZValue(areazvalue);
                 }
             }
-        }
+        });
     }
 
     // Draw ways
     if (ui->ways_checkbox->isChecked())
     {
         std::unordered_set<Coord, CoordHash> crossroads;
-        auto ways = mainprg_.ds_.all_ways();
-
-        for (auto wayid : ways)
+        mainprg_.ds_.for_each_way([&](WayView const& way)
         {
-            auto coords = mainprg_.ds_.get_way_coords(wayid);
+            auto wayid = way.id;
+            auto coords = way.coordinates;
 
             // Add endpoints to crossroad set
             crossroads.insert(coords.front());
@@ -380,7 +367,7 @@ void MainWindow::update_view()
                 auto [x, y] = coord;
                 if (!errors && (x == NO_VALUE || y == NO_VALUE))
                 {
-                    errorout << "Error from GUI: get_way_coords(" << wayid << ") returned impossible coordinate (";
+                    errorout << "Error from GUI: way " << wayid << " has impossible coordinate (";
                     if (coord == NO_COORD)
                     {
                         errorout << "NO_COORD";
@@ -419,7 +406,7 @@ void MainWindow::update_view()
 
                 prevcoord = coord;
             }
-        }
+        });
 
         // Draw crossroads
         if (ui->xroads_checkbox->isChecked())
@@ -16,6 +16,21 @@
 # NOTE 2: If you uncomment or recomment the line, remember to recompile EVERYTHING by selecting
 # "Rebuild all" from the Build menu
 
+# Uncomment the line below to let the compiler use AVX2 instructions (e.g. for computing distances of places)
+# NOTE: The program will then only run on processors that support AVX2. If you uncomment or recomment the line,
+# remember to recompile EVERYTHING by selecting "Rebuild all" from the Build menu
+#QMAKE_CXXFLAGS += -mavx2
+
+# Uncomment the line below to use std::unordered_map instead of FlatHashMap for the main containers
+# (e.g. to compare the two with perftest). If you uncomment or recomment the line, remember to
+# recompile EVERYTHING by selecting "Rebuild all" from the Build menu
+#DEFINES += USE_STD_UNORDERED_MAP
+
+# Uncomment the line below to make perftest also report the number of heap allocations made
+# while adding the data and while running the commands. If you uncomment or recomment the line,
+# remember to recompile EVERYTHING by selecting "Rebuild all" from the Build menu
+#DEFINES += COUNT_ALLOCATIONS
+
 QT       += core gui
 
 CONFIG += c++17 warn_on